@@ -0,0 +1,254 @@
+/**
+ * @file EventChannel.h
+ * @brief Compile-time typed event channels.
+ */
+#ifndef BALLOON_EVENTCHANNEL_H
+#define BALLOON_EVENTCHANNEL_H
+
+#include "Balloon/IEventManager.h"
+#include "Balloon/RefCount.h"
+
+namespace balloon {
+    inline namespace v1 {
+        /**
+         * @brief An event carrying a payload of type T by value.
+         *
+         * The payload is stored inline in the event, so no data stack or Variant is involved.
+         * T should be a plain copyable structure.
+         */
+        template<typename T>
+        class TypedEvent final : public IEvent {
+        public:
+            explicit TypedEvent(EventType type) : m_Type(type) {}
+
+            TypedEvent(const TypedEvent &rhs) = delete;
+            TypedEvent(TypedEvent &&rhs) noexcept = delete;
+
+            TypedEvent &operator=(const TypedEvent &rhs) = delete;
+            TypedEvent &operator=(TypedEvent &&rhs) noexcept = delete;
+
+            int AddRef() const override { return m_RefCount.AddRef(); }
+
+            int Release() const override {
+                int r = m_RefCount.Release();
+                if (r == 0) {
+                    std::atomic_thread_fence(std::memory_order_acquire);
+                    delete this;
+                }
+                return r;
+            }
+
+            EventType GetType() const override { return m_Type; }
+            void SetType(EventType type) override { m_Type = type; }
+
+            int GetFlag() const override { return m_Flag; }
+            void SetFlag(int flag) override { m_Flag = flag; }
+
+            IDataStack *GetDataStack() const override { return nullptr; }
+            void SetDataStack(IDataStack *stack) override {}
+            IDataStack *AcquireDataStack() override { return nullptr; }
+
+            const void *GetPayload(size_t *size) const override {
+                if (size)
+                    *size = sizeof(T);
+                return &m_Payload;
+            }
+
+            /**
+             * @brief Gets the payload of the event.
+             * @return A reference to the payload.
+             */
+            const T &GetValue() const { return m_Payload; }
+
+            /**
+             * @brief Sets the payload of the event.
+             * @param value The payload to copy into the event.
+             */
+            void SetValue(const T &value) { m_Payload = value; }
+
+            /**
+             * @brief Checks if the event is referenced by anyone other than its creator.
+             * @return True if other references are held, false otherwise.
+             */
+            bool IsShared() const { return m_RefCount.GetCount() != 0; }
+
+        private:
+            ~TypedEvent() override = default;
+
+            mutable RefCount m_RefCount;
+            EventType m_Type;
+            int m_Flag = 0;
+            T m_Payload = {};
+        };
+
+        /**
+         * @brief Listener receiving the payload of typed events by const reference.
+         *
+         * Events without a payload of matching size are ignored.
+         */
+        template<typename T>
+        class ITypedEventListener : public IEventListener {
+        public:
+            /**
+             * @brief Called when a typed event occurs.
+             *
+             * @param payload The payload of the event.
+             * @param event Pointer to the event that occurred.
+             * @return An integer representing the result of the event handling, 0 removes the listener.
+             */
+            virtual int OnEvent(const T &payload, const IEvent *event) = 0;
+
+            int OnEvent(const IEvent *event) final {
+                size_t size = 0;
+                const void *payload = event->GetPayload(&size);
+                if (!payload || size != sizeof(T))
+                    return 1;
+                return OnEvent(*static_cast<const T *>(payload), event);
+            }
+        };
+
+        /**
+         * @brief A typed channel built on an event type of the event manager.
+         *
+         * Sending through a channel delivers the payload straight to typed listeners without boxing it
+         * into a data stack. The event object is reused between sends unless a listener keeps a reference.
+         */
+        template<typename T>
+        class EventChannel {
+        public:
+            EventChannel() = default;
+
+            EventChannel(IEventManager *manager, const char *name) { Init(manager, name); }
+
+            EventChannel(const EventChannel &rhs) = delete;
+            EventChannel(EventChannel &&rhs) noexcept = delete;
+
+            ~EventChannel() {
+                if (m_Event) {
+                    m_Event->Release();
+                    m_Event = nullptr;
+                }
+            }
+
+            EventChannel &operator=(const EventChannel &rhs) = delete;
+            EventChannel &operator=(EventChannel &&rhs) noexcept = delete;
+
+            /**
+             * @brief Binds the channel to the event type of the given name, adding the type if necessary.
+             *
+             * @param manager Pointer to the event manager.
+             * @param name The name of the event type.
+             * @return True if the channel is bound, false otherwise.
+             */
+            bool Init(IEventManager *manager, const char *name) {
+                if (!manager || !name)
+                    return false;
+
+                EventType type = manager->GetEventType(name);
+                if (type == static_cast<EventType>(-1))
+                    type = manager->AddEventType(name);
+                if (type == static_cast<EventType>(-1))
+                    return false;
+
+                m_Manager = manager;
+                m_Type = type;
+                return true;
+            }
+
+            /**
+             * @brief Checks if the channel is bound to an event type.
+             * @return True if the channel is bound, false otherwise.
+             */
+            bool IsValid() const { return m_Manager != nullptr; }
+
+            /**
+             * @brief Gets the event type of the channel.
+             * @return The event type identifier.
+             */
+            EventType GetType() const { return m_Type; }
+
+            /**
+             * @brief Sends a payload to the listeners of the channel.
+             *
+             * @param payload The payload to send.
+             * @param flag The flag of the event.
+             * @return True if the event was sent successfully, false otherwise.
+             */
+            bool Send(const T &payload, int flag = 0) {
+                if (!m_Manager)
+                    return false;
+
+                if (m_Event && m_Event->IsShared()) {
+                    m_Event->Release();
+                    m_Event = nullptr;
+                }
+
+                if (!m_Event)
+                    m_Event = new TypedEvent<T>(m_Type);
+
+                // Hold a reference while sending so that nested sends do not overwrite the payload in flight.
+                auto *event = m_Event;
+                event->AddRef();
+                event->SetValue(payload);
+                event->SetFlag(flag);
+                bool ret = m_Manager->SendEvent(event);
+                event->Release();
+                return ret;
+            }
+
+            /**
+             * @brief Posts a payload to the deferred event queue of the channel.
+             *
+             * This function can be called from any thread.
+             *
+             * @param payload The payload to post.
+             * @param flag The flag of the event.
+             * @return True if the event was queued successfully, false otherwise.
+             */
+            bool Post(const T &payload, int flag = 0) const {
+                if (!m_Manager)
+                    return false;
+
+                auto *event = new TypedEvent<T>(m_Type);
+                event->SetValue(payload);
+                event->SetFlag(flag);
+                bool ret = m_Manager->PostEvent(event);
+                event->Release();
+                return ret;
+            }
+
+            /**
+             * @brief Adds a typed listener to the channel.
+             *
+             * @param listener Pointer to the listener object to be added.
+             * @param priority The priority of the listener, higher values are called first.
+             * @param phase The dispatch phase of the listener.
+             * @return True if the listener was added successfully, false otherwise.
+             */
+            bool AddListener(ITypedEventListener<T> *listener, int priority = 0, EventPhase phase = EVENT_PHASE_NORMAL) {
+                if (!m_Manager)
+                    return false;
+                return m_Manager->AddListenerEx(m_Type, listener, priority, phase);
+            }
+
+            /**
+             * @brief Removes a typed listener from the channel.
+             *
+             * @param listener Pointer to the listener object to be removed.
+             * @return True if the listener was removed successfully, false otherwise.
+             */
+            bool RemoveListener(ITypedEventListener<T> *listener) {
+                if (!m_Manager)
+                    return false;
+                return m_Manager->RemoveListener(m_Type, listener);
+            }
+
+        private:
+            IEventManager *m_Manager = nullptr;
+            EventType m_Type = static_cast<EventType>(-1);
+            TypedEvent<T> *m_Event = nullptr;
+        };
+    }
+}
+
+#endif // BALLOON_EVENTCHANNEL_H
@@ -5,6 +5,7 @@
 #ifndef BALLOON_IDATASTACK_H
 #define BALLOON_IDATASTACK_H
 
+#include <cstddef>
 #include <cstdint>
 
 #include "Balloon/IWeakRefFlag.h"
@@ -34,6 +35,87 @@ namespace balloon {
 #define DATA_SUBTYPE_FLOAT32  ((uint8_t)(8 << 3)) /* _1000___ */
 #define DATA_SUBTYPE_FLOAT64  ((uint8_t)(9 << 3)) /* _1001___ */
 
+        /**
+         * @brief Maps a C++ type to the tag of the data stack value holding it.
+         */
+        template <typename T>
+        struct DataTraits;
+
+        template <> struct DataTraits<bool> { static constexpr uint8_t TAG = DATA_TYPE_BOOL; };
+        template <> struct DataTraits<char> { static constexpr uint8_t TAG = DATA_TYPE_CHAR; };
+        template <> struct DataTraits<uint8_t> { static constexpr uint8_t TAG = DATA_TYPE_NUM | DATA_SUBTYPE_UINT8; };
+        template <> struct DataTraits<int8_t> { static constexpr uint8_t TAG = DATA_TYPE_NUM | DATA_SUBTYPE_INT8; };
+        template <> struct DataTraits<uint16_t> { static constexpr uint8_t TAG = DATA_TYPE_NUM | DATA_SUBTYPE_UINT16; };
+        template <> struct DataTraits<int16_t> { static constexpr uint8_t TAG = DATA_TYPE_NUM | DATA_SUBTYPE_INT16; };
+        template <> struct DataTraits<uint32_t> { static constexpr uint8_t TAG = DATA_TYPE_NUM | DATA_SUBTYPE_UINT32; };
+        template <> struct DataTraits<int32_t> { static constexpr uint8_t TAG = DATA_TYPE_NUM | DATA_SUBTYPE_INT32; };
+        template <> struct DataTraits<uint64_t> { static constexpr uint8_t TAG = DATA_TYPE_NUM | DATA_SUBTYPE_UINT64; };
+        template <> struct DataTraits<int64_t> { static constexpr uint8_t TAG = DATA_TYPE_NUM | DATA_SUBTYPE_INT64; };
+        template <> struct DataTraits<float> { static constexpr uint8_t TAG = DATA_TYPE_NUM | DATA_SUBTYPE_FLOAT32; };
+        template <> struct DataTraits<double> { static constexpr uint8_t TAG = DATA_TYPE_NUM | DATA_SUBTYPE_FLOAT64; };
+        template <> struct DataTraits<const char *> { static constexpr uint8_t TAG = DATA_TYPE_STR; };
+        template <> struct DataTraits<void *> { static constexpr uint8_t TAG = DATA_TYPE_PTR; };
+
+        /**
+         * @brief Describes one value of a bulk transfer between a data stack and a caller structure.
+         *
+         * Strings are transferred as a const char * member, which GetValues points into the data stack.
+         * Buffers are copied into the structure, size bytes at the given offset.
+         */
+        typedef struct DataField {
+            uint8_t tag; /**< Tag of the value. */
+            uint32_t offset; /**< Offset of the member in the structure. */
+            uint32_t size; /**< Size of the member in bytes. */
+        } DataField;
+
+/**
+ * @brief Builds the DataField of a structure member of a type supported by DataTraits.
+ */
+#define DATA_FIELD(type, member) \
+    { balloon::DataTraits<decltype(((type *)nullptr)->member)>::TAG, (uint32_t)offsetof(type, member), (uint32_t)sizeof(((type *)nullptr)->member) }
+
+/**
+ * @brief Builds the DataField of a structure member transferred as a buffer.
+ */
+#define DATA_FIELD_BUFFER(type, member) \
+    { DATA_TYPE_BUF, (uint32_t)offsetof(type, member), (uint32_t)sizeof(((type *)nullptr)->member) }
+
+        /**
+         * @brief Releases a buffer stored by reference.
+         * @param data The buffer.
+         * @param size The size of the buffer.
+         * @param userdata The user data given along with the buffer.
+         */
+        typedef void (*DataBufferRelease)(void *data, size_t size, void *userdata);
+
+        typedef enum DataStackFlag {
+            DATA_STACK_DEFAULT = 0, /**< Payloads are allocated one by one. */
+            DATA_STACK_ARENA = 1, /**< Payloads are allocated from an arena owned by the stack and released at once on Clear. */
+        } DataStackFlag;
+
+        /**
+         * @brief Parameters of the "DataStack" object factory, version 2. Version 1 ignores its data.
+         */
+        typedef struct DataStackDesc {
+            uint32_t flags; /**< Combination of DataStackFlag values. */
+            size_t capacity; /**< Number of values to reserve, 0 for none. */
+            size_t arenaSize; /**< Bytes of the initial arena chunk, 0 for the default. Ignored without DATA_STACK_ARENA. */
+        } DataStackDesc;
+
+        /**
+         * @interface IDataStack
+         * @brief Stack of typed values.
+         *
+         * Strings shorter than 14 characters and buffers up to 14 bytes are stored inside the value
+         * cells of the stack, larger ones in separate payloads. Pointers returned by GetString, GetBuffer,
+         * GetValues and GetArray therefore point into the stack itself for small values: they are only
+         * valid until the next modification of the data stack, any value included, as Push, SetValue,
+         * Swap, Clear or Deserialize may move or overwrite the cells. Releasing the stack invalidates
+         * them too. Copy a string or buffer to keep it across modifications.
+         *
+         * @note Strings used to be allocated separately, so that their pointers survived modifications of
+         *       other values. Code holding a string pointer across a Push must copy the string instead.
+         */
         class IDataStack {
         public:
             /**
@@ -79,6 +161,9 @@ namespace balloon {
 
             /**
              * @brief Sets the minimum capacity of the data stack.
+             *
+             * Stacks created with DATA_STACK_ARENA also pre-size their payload arena.
+             *
              * @param cap The minimum capacity to reserve.
              */
             virtual void Reserve(size_t cap) = 0;
@@ -219,9 +304,194 @@ namespace balloon {
             virtual bool Merge(const IDataStack *other) = 0;
             virtual IDataStack *Separate() = 0;
 
+            /**
+             * @brief Pushes the members of a structure described by fields.
+             * @param fields The descriptors of the values.
+             * @param count The number of descriptors.
+             * @param base The address of the structure.
+             * @return The number of values pushed.
+             */
+            virtual size_t PushValues(const DataField *fields, size_t count, const void *base) = 0;
+
+            /**
+             * @brief Reads consecutive values into the members of a structure described by fields.
+             *
+             * Numbers are converted to the tag of the field. Strings point into the data stack
+             * and are only valid until the next modification of the data stack, see IDataStack.
+             *
+             * @param index The index of the first value.
+             * @param fields The descriptors of the values.
+             * @param count The number of descriptors.
+             * @param base The address of the structure.
+             * @return The number of values read.
+             */
+            virtual size_t GetValues(size_t index, const DataField *fields, size_t count, void *base) const = 0;
+
+            /**
+             * @brief Pushes an array of values of the same tag.
+             * @param tag The tag of the values, buffers are not supported.
+             * @param values The packed array of values.
+             * @param count The number of values.
+             * @return The number of values pushed.
+             */
+            virtual size_t PushArray(uint8_t tag, const void *values, size_t count) = 0;
+
+            /**
+             * @brief Reads consecutive values into an array, converting them to the given tag.
+             *
+             * Strings point into the data stack and are only valid until the next modification
+             * of the data stack, see IDataStack.
+             *
+             * @param index The index of the first value.
+             * @param tag The tag of the values, buffers are not supported.
+             * @param values The packed array receiving the values.
+             * @param count The capacity of the array.
+             * @return The number of values read.
+             */
+            virtual size_t GetArray(size_t index, uint8_t tag, void *values, size_t count) const = 0;
+
+            /**
+             * @brief Writes the values and cursors of the data stack in a portable binary form.
+             *
+             * The output is versioned and little-endian. A single length-prefixed block
+             * that can be embedded in other files or messages. Strings keep their terminator,
+             * so other readers of the block may use them without copying.
+             * Pointers are not meaningful outside the process and are written as null pointers.
+             *
+             * @param buffer The destination buffer, may be nullptr to query the required size.
+             * @param size The size of the destination buffer.
+             * @return The number of bytes required. Nothing is written if it exceeds size.
+             */
+            virtual size_t Serialize(void *buffer, size_t size) const = 0;
+
+            /**
+             * @brief Replaces the content of the data stack with data written by Serialize.
+             *
+             * Strings and buffers are copied into the data stack, into its arena if it has one,
+             * so the data can be released or reused as soon as the call returns.
+             *
+             * @param data The serialized data.
+             * @param size The number of bytes available.
+             * @return The number of bytes consumed, 0 if the data is malformed, in which case the data stack is unchanged.
+             */
+            virtual size_t Deserialize(const void *data, size_t size) = 0;
+
+            /**
+             * @brief Stores a buffer by reference instead of copying it.
+             *
+             * Copies of the value, clones of the data stack and events carrying it all refer to the
+             * same memory, which must not change while referenced. Buffers small enough to fit in
+             * the value are copied and released right away.
+             *
+             * @param index The index of the value.
+             * @param buf The buffer.
+             * @param size The size of the buffer.
+             * @param release Called once no value refers to the buffer anymore, even if storing fails.
+             *                nullptr borrows the buffer, the caller keeps it alive as long as any copy of the value.
+             * @param userdata The user data passed to release.
+             */
+            virtual void SetBuffer(size_t index, void *buf, size_t size, DataBufferRelease release, void *userdata) = 0;
+
+            /**
+             * @brief Stores a new reference counted buffer to be filled in place.
+             * @param index The index of the value.
+             * @param size The size of the buffer.
+             * @return The buffer, valid until the data stack is modified, nullptr on failure.
+             * @note Fill the buffer before the data stack is cloned or shared, copies refer to the same memory.
+             */
+            virtual void *AllocBuffer(size_t index, size_t size) = 0;
+
+            void SetBuffer(void *buf, size_t size, DataBufferRelease release, void *userdata) {
+                SetBuffer(Top(), buf, size, release, userdata);
+            }
+
+            void *AllocBuffer(size_t size) { return AllocBuffer(Top(), size); }
+
+            /**
+             * @brief Reads a value as the type of the given tag, without loss.
+             *
+             * A value of exactly this tag is copied as is. Numbers of another width, signedness or
+             * precision are converted only if the requested type holds them exactly: integers in range,
+             * floating point values with no fractional part for integers, and integers small enough
+             * for floating point types. Other types never convert.
+             *
+             * @param index The index of the value.
+             * @param tag The tag of the requested type, see DataTraits.
+             * @param value Receives the value, left unchanged on failure.
+             * @param size The size of the requested type.
+             * @return True if the value was read, false if it does not fit the requested type.
+             */
+            virtual bool GetValue(size_t index, uint8_t tag, void *value, size_t size) const = 0;
+
+            /**
+             * @brief Sets a string value, copying the string.
+             * @param index The index of the value.
+             * @param str The null-terminated string.
+             */
+            virtual void SetString(size_t index, const char *str) = 0;
+
+            void SetString(const char *str) { SetString(Top(), str); }
+
+            /**
+             * @brief Reads a value as T, a type supported by DataTraits.
+             *
+             * The type is resolved at compile time. A value already of type T costs a single
+             * call and tag compare, other values go through the checked conversion of GetValue.
+             *
+             * @return True if the value was read, false if it does not fit T.
+             */
+            template <typename T>
+            bool TryGet(size_t index, T &value) const {
+                return GetValue(index, DataTraits<T>::TAG, &value, sizeof(T));
+            }
+
+            template <typename T>
+            bool TryGet(T &value) const { return TryGet<T>(Top(), value); }
+
+            /**
+             * @brief Gets a value as T, a type supported by DataTraits.
+             * @return The value, or T() if it does not fit T. Use TryGet to tell both apart.
+             */
+            template <typename T>
+            T Get(size_t index) const {
+                T value = T();
+                TryGet<T>(index, value);
+                return value;
+            }
+
+            template <typename T>
+            T Get() const { return Get<T>(Top()); }
+
+            /**
+             * @brief Sets a value of type T, a type supported by DataTraits.
+             */
+            template <typename T>
+            void Set(size_t index, T value) {
+                static_assert(DataTraits<T>::TAG != DATA_TYPE_NONE, "Unsupported data type");
+                SetValue(index, value);
+            }
+
+            template <typename T>
+            void Set(T value) { Set<T>(Top(), value); }
+
+            template <typename T>
+            size_t PushArray(const T *values, size_t count) {
+                return PushArray(DataTraits<T>::TAG, values, count);
+            }
+
+            template <typename T>
+            size_t GetArray(size_t index, T *values, size_t count) const {
+                return GetArray(index, DataTraits<T>::TAG, values, count);
+            }
+
         protected:
             virtual ~IDataStack() = default;
         };
+
+        template <>
+        inline void IDataStack::Set<const char *>(size_t index, const char *value) {
+            SetString(index, value);
+        }
     }
 }
 
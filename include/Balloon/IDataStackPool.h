@@ -0,0 +1,50 @@
+/**
+ * @file IDataStackPool.h
+ * @brief The interface of the pooled data stack factory.
+ */
+#ifndef BALLOON_IDATASTACKPOOL_H
+#define BALLOON_IDATASTACKPOOL_H
+
+#include <cstddef>
+
+#include "Balloon/IObjectFactory.h"
+
+namespace balloon {
+    inline namespace v1 {
+        /**
+         * @interface IDataStackPool
+         * @brief Object factory recycling data stacks.
+         *
+         * Registered as the "DataStackPool" factory. CreateInstance accepts the same DataStackDesc
+         * as the "DataStack" factory. Stacks released to zero references, or passed to DestroyInstance,
+         * are cleared and kept with their capacity for the next CreateInstance.
+         */
+        class IDataStackPool : public IObjectFactory {
+        public:
+            /**
+             * @brief Sets the maximum number of bytes retained by pooled stacks.
+             * @param bytes The limit in bytes, stacks released beyond it are destroyed.
+             */
+            virtual void SetByteLimit(size_t bytes) = 0;
+
+            /**
+             * @brief Gets the maximum number of bytes retained by pooled stacks.
+             * @return The limit in bytes.
+             */
+            virtual size_t GetByteLimit() const = 0;
+
+            /**
+             * @brief Gets the number of bytes currently retained by pooled stacks.
+             * @return The retained bytes.
+             */
+            virtual size_t GetPooledBytes() const = 0;
+
+            /**
+             * @brief Destroys all the pooled stacks.
+             */
+            virtual void Trim() = 0;
+        };
+    }
+}
+
+#endif // BALLOON_IDATASTACKPOOL_H
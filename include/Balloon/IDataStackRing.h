@@ -0,0 +1,98 @@
+/**
+ * @file IDataStackRing.h
+ * @brief The interface of the data stack ring.
+ */
+#ifndef BALLOON_IDATASTACKRING_H
+#define BALLOON_IDATASTACKRING_H
+
+#include <cstddef>
+
+#include "Balloon/IDataStack.h"
+
+/**
+ * @brief The maximum number of slots of a data stack ring.
+ */
+#define DATA_STACK_RING_MAX_CAPACITY ((size_t)1 << 16)
+
+namespace balloon {
+    inline namespace v1 {
+        /**
+         * @brief Parameters of the "DataStackRing" object factory.
+         */
+        typedef struct DataStackRingDesc {
+            size_t capacity; /**< Number of slots, rounded up to a power of two. Creation fails above DATA_STACK_RING_MAX_CAPACITY. */
+            DataStackDesc stack; /**< Parameters of the data stack of each slot. */
+        } DataStackRingDesc;
+
+        /**
+         * @interface IDataStackRing
+         * @brief Bounded single-producer single-consumer queue of pre-allocated data stacks.
+         *
+         * One thread writes payloads into the slots while another reads them, without locks
+         * and without allocations once every slot has been written and reached its working size.
+         * Slots are allocated the first time the producer reaches them.
+         * The slots belong to the ring, they must not be released nor kept after EndRead.
+         * Clone a slot to keep its content, the clone shares the values until modified.
+         */
+        class IDataStackRing {
+        public:
+            /**
+             * @brief Increases the reference count of the object.
+             * @return The new reference count.
+             */
+            virtual int AddRef() const = 0;
+
+            /**
+             * @brief Decreases the reference count of the object. Destroys the object if the reference count reaches zero.
+             * @return The new reference count.
+             */
+            virtual int Release() const = 0;
+
+            /**
+             * @brief Gets the number of slots.
+             * @return The number of slots.
+             */
+            virtual size_t Capacity() const = 0;
+
+            /**
+             * @brief Gets the number of published slots not read yet.
+             * @return The number of slots, exact only when called from the producer or the consumer.
+             */
+            virtual size_t Size() const = 0;
+
+            /**
+             * @brief Gets the next free slot, cleared. Producer only.
+             *
+             * A slot whose values are still shared with a clone gets new storage instead of being
+             * cleared in place, which allocates. Release clones of a slot before the producer comes
+             * back to it to keep writes allocation free.
+             *
+             * @return The slot to fill, nullptr if the ring is full.
+             */
+            virtual IDataStack *BeginWrite() = 0;
+
+            /**
+             * @brief Publishes the slot obtained by BeginWrite to the consumer. Producer only.
+             * @note Must only follow a BeginWrite which returned a slot.
+             */
+            virtual void EndWrite() = 0;
+
+            /**
+             * @brief Gets the oldest published slot. Consumer only.
+             * @return The slot to read, nullptr if the ring is empty.
+             */
+            virtual IDataStack *BeginRead() = 0;
+
+            /**
+             * @brief Gives the slot obtained by BeginRead back to the producer. Consumer only.
+             * @note Must only follow a BeginRead which returned a slot.
+             */
+            virtual void EndRead() = 0;
+
+        protected:
+            virtual ~IDataStackRing() = default;
+        };
+    }
+}
+
+#endif // BALLOON_IDATASTACKRING_H
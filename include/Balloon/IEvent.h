@@ -66,6 +66,23 @@ namespace balloon {
              */
             virtual void SetDataStack(IDataStack *stack) = 0;
 
+            /**
+             * @brief Gets the data stack owned by the event and attaches it to the event.
+             *
+             * The data stack is pooled together with the event and is cleared when the event is recycled,
+             * so it must not be released by the caller.
+             *
+             * @return A pointer to the IDataStack object.
+             */
+            virtual IDataStack *AcquireDataStack() = 0;
+
+            /**
+             * @brief Gets the typed payload carried by the event.
+             * @param size A pointer to receive the size of the payload in bytes, can be nullptr.
+             * @return A pointer to the payload, or nullptr if the event carries no typed payload.
+             */
+            virtual const void *GetPayload(size_t *size) const = 0;
+
         protected:
             virtual ~IEvent() = default;
         };
@@ -0,0 +1,65 @@
+/**
+ * @file IEventJournal.h
+ * @brief The interface of event recording and replay.
+ */
+#ifndef BALLOON_IEVENTJOURNAL_H
+#define BALLOON_IEVENTJOURNAL_H
+
+namespace balloon {
+    inline namespace v1 {
+        /**
+         * @interface IEventJournal
+         * @brief The interface of event recording and replay.
+         *
+         * Registered as the "ej" interface. A recording writes every event sent or posted through
+         * the event manager to a journal file, with its frame, data stack and payload. A replay sends
+         * the events of a journal again with their original frame timing, one recorded frame per
+         * processed frame. Both run on the game thread and stop on their own at shutdown.
+         */
+        class IEventJournal {
+        public:
+            /**
+             * @brief Start recording events to a journal file, replacing the current recording.
+             * @param path The native path of the journal file, created or truncated.
+             * @return True if the recording started, false otherwise.
+             */
+            virtual bool StartRecording(const char *path) = 0;
+
+            /**
+             * @brief Stop recording events and close the journal file.
+             */
+            virtual void StopRecording() = 0;
+
+            /**
+             * @brief Check if events are being recorded.
+             * @return True if events are being recorded, false otherwise.
+             */
+            virtual bool IsRecording() const = 0;
+
+            /**
+             * @brief Start replaying a journal file, replacing the current replay.
+             * @param path The native path of the journal file.
+             * @param nested True to also replay the events that listeners sent while another event was dispatched.
+             *               They are skipped by default, since replaying the outer event makes the listeners send them again.
+             * @return True if the replay started, false if the file is not a journal of this version.
+             */
+            virtual bool StartReplay(const char *path, bool nested = false) = 0;
+
+            /**
+             * @brief Stop replaying events.
+             */
+            virtual void StopReplay() = 0;
+
+            /**
+             * @brief Check if a journal is being replayed.
+             * @return True until the last recorded event has been sent, false otherwise.
+             */
+            virtual bool IsReplaying() const = 0;
+
+        protected:
+            virtual ~IEventJournal() = default;
+        };
+    }
+}
+
+#endif // BALLOON_IEVENTJOURNAL_H
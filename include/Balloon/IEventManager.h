@@ -5,10 +5,29 @@
 #ifndef BALLOON_IEVENTMANAGER_H
 #define BALLOON_IEVENTMANAGER_H
 
+#include <cstdint>
+#include <type_traits>
+
 #include "Balloon/IEvent.h"
 
 namespace balloon {
     inline namespace v1 {
+        /**
+         * @brief Computes the 32-bit FNV-1a hash of an event type name.
+         *
+         * The function is constexpr, so the hash of a literal name can be computed at compile time
+         * with BALLOON_EVENT_HASH and passed to IEventManager::GetEventTypeByHash.
+         *
+         * @param name The name of the event type.
+         * @param hash The initial hash value.
+         * @return The hash of the name.
+         */
+        constexpr uint32_t HashEventName(const char *name, uint32_t hash = 2166136261u) {
+            return *name ? HashEventName(name + 1, (hash ^ static_cast<uint8_t>(*name)) * 16777619u) : hash;
+        }
+
+#define BALLOON_EVENT_HASH(name) (std::integral_constant<uint32_t, ::balloon::HashEventName(name)>::value)
+
         /**
          * @brief Interface for event listeners.
          *
@@ -25,10 +44,108 @@ namespace balloon {
             virtual int OnEvent(const IEvent *event) = 0;
         };
 
+        /**
+         * @brief Interface for listeners handling events on a worker thread.
+         *
+         * The event is kept alive until OnEventCompleted returns, so neither the event nor its data stack
+         * should be modified once it has been sent.
+         */
+        class IAsyncEventListener {
+        public:
+            /**
+             * @brief Called by EventManager on a worker thread after the event has been sent.
+             *
+             * @param event Pointer to the event that occurred.
+             * @return An integer representing the result of the event handling, passed to OnEventCompleted.
+             */
+            virtual int OnEventAsync(const IEvent *event) = 0;
+
+            /**
+             * @brief Called by EventManager on the game thread in a frame after OnEventAsync returned.
+             *
+             * @param event Pointer to the event that occurred.
+             * @param result The value returned by OnEventAsync.
+             */
+            virtual void OnEventCompleted(const IEvent *event, int result) = 0;
+        };
+
+        /**
+         * @brief Interface for listeners receiving the posted events of a type in batches.
+         *
+         * EventManager calls OnEvents once per frame with all events of the type dispatched from the deferred queue.
+         */
+        class IEventBatchListener {
+        public:
+            /**
+             * @brief Called by EventManager with the posted events of a frame.
+             *
+             * @param events Pointer to the array of events, in posting order.
+             * @param count The number of events in the array.
+             * @return An integer representing the result of the event handling, 0 removes the listener.
+             */
+            virtual int OnEvents(const IEvent *const *events, size_t count) = 0;
+        };
+
+        /**
+         * @brief Enumeration of per-frame coalescing modes for posted events.
+         */
+        typedef enum EventCoalesceMode {
+            EVENT_COALESCE_NONE = 0,    /**< Every posted event is dispatched. */
+            EVENT_COALESCE_LAST = 1,    /**< Only the last event posted in a frame is dispatched for each key. */
+            EVENT_COALESCE_MERGE = 2,   /**< Events posted in a frame are merged into the first one for each key. */
+        } EventCoalesceMode;
+
+        /**
+         * @brief Callback merging a posted event into an earlier event with the same key.
+         *
+         * @param target The earlier event that will be dispatched.
+         * @param source The later event that will be dropped.
+         * @param userdata The user data passed to IEventManager::SetEventCoalescing.
+         */
+        typedef void (*EventMergeCallback)(IEvent *target, const IEvent *source, void *userdata);
+
+        /**
+         * @brief Identifier of a scheduled event, 0 is never a valid timer.
+         */
+        typedef size_t EventTimer;
+
+        /**
+         * @brief Enumeration of the units of scheduling delays.
+         */
+        typedef enum EventTimerUnit {
+            EVENT_TIMER_FRAMES = 0,       /**< The delay is a number of frames. */
+            EVENT_TIMER_MILLISECONDS = 1, /**< The delay is a number of milliseconds. */
+        } EventTimerUnit;
+
+        /**
+         * @brief Enumeration of listener dispatch phases.
+         *
+         * Listeners of a phase are always called before listeners of the following phase.
+         */
+        typedef enum EventPhase {
+            EVENT_PHASE_PRE = 0,    /**< Phase for early filters running before ordinary listeners. */
+            EVENT_PHASE_NORMAL = 1, /**< Phase for ordinary listeners. */
+            EVENT_PHASE_POST = 2,   /**< Phase for listeners observing the final outcome of an event. */
+        } EventPhase;
+
+        /**
+         * @brief Counters of the event object pool.
+         */
+        struct EventPoolStats {
+            size_t acquired;        /**< The number of events handed out by the pool. */
+            size_t reused;          /**< The number of events served from the free list. */
+            size_t pooled;          /**< The number of events currently held in the free list. */
+            size_t stackAcquired;   /**< The number of data stacks acquired through IEvent::AcquireDataStack. */
+            size_t stackReused;     /**< The number of acquired data stacks that were recycled with their event. */
+        };
+
         /**
          * @brief Interface for event management.
          *
          * This class represents an interface for managing events and event types.
+         *
+         * All functions can be called from any thread. Dispatch reads an immutable snapshot of the listeners
+         * without locking, and listener changes publish a new snapshot used by dispatches started afterwards.
          */
         class IEventManager {
         public:
@@ -53,6 +170,9 @@ namespace balloon {
             /**
              * @brief Get the name of the event type associated with the given event type identifier.
              *
+             * The string may be kept and read from any thread. It stays valid after the type is renamed,
+             * until the event manager is reset.
+             *
              * @param type The event type identifier.
              * @return The name of the event type as a null-terminated string.
              */
@@ -104,6 +224,9 @@ namespace balloon {
             /**
              * @brief Send the given event to all appropriate listeners.
              *
+             * If an event of the same type is already being dispatched, the event is queued
+             * and delivered once the outer dispatch completes.
+             *
              * @param event Pointer to the event to be sent.
              * @return True if the event was sent successfully, false otherwise.
              */
@@ -130,6 +253,9 @@ namespace balloon {
             /**
              * @brief Add a listener for the specified event type.
              *
+             * A listener added while the event type is being dispatched receives events
+             * once the outer dispatch completes.
+             *
              * @param eventType The event type identifier to listen for.
              * @param listener Pointer to the listener object to be added.
              * @return True if the listener was added successfully, false otherwise.
@@ -139,7 +265,11 @@ namespace balloon {
             /**
              * @brief Add a listener for the specified event name.
              *
-             * @param eventName The name of the event to listen for.
+             * Event names may be namespaced with '/', e.g. "physics/contact/begin". A name whose last segment
+             * is "*", e.g. "physics/contact/" followed by "*", subscribes to every event type under that prefix,
+             * including types added later, and "*" alone subscribes to every event type.
+             *
+             * @param eventName The name of the event, or the pattern of the events, to listen for.
              * @param listener Pointer to the listener object to be added.
              * @return True if the listener was added successfully, false otherwise.
              */
@@ -148,6 +278,8 @@ namespace balloon {
             /**
              * @brief Remove a listener for the specified event type.
              *
+             * A listener removed while the event type is being dispatched is not called anymore.
+             *
              * @param eventType The event type identifier to remove the listener from.
              * @param listener Pointer to the listener object to be removed.
              * @return True if the listener was removed successfully, false otherwise.
@@ -157,11 +289,223 @@ namespace balloon {
             /**
              * @brief Remove a listener for the specified event name.
              *
-             * @param eventName The name of the event to remove the listener from.
+             * Removing a pattern removes the listener from every event type it was added to through the pattern.
+             *
+             * @param eventName The name of the event, or the pattern of the events, to remove the listener from.
              * @param listener Pointer to the listener object to be removed.
              * @return True if the listener was removed successfully, false otherwise.
              */
             virtual bool RemoveListener(const char *eventName, IEventListener *listener) = 0;
+
+            /**
+             * @brief Add an asynchronous listener for the specified event type.
+             *
+             * SendEvent hands the event to a worker pool after the synchronous listeners returned,
+             * and the completion is reported on the game thread in a later frame.
+             *
+             * @param eventType The event type identifier to listen for.
+             * @param listener Pointer to the asynchronous listener object to be added.
+             * @return True if the listener was added successfully, false otherwise.
+             */
+            virtual bool AddAsyncListener(EventType eventType, IAsyncEventListener *listener) = 0;
+
+            /**
+             * @brief Remove an asynchronous listener for the specified event type.
+             *
+             * Waits for the calls of the listener running on worker threads. Called from OnEventAsync of the
+             * listener itself, it waits for the other calls only, the listener must then stay alive until its
+             * own call returns. Pending completions of the listener are dropped.
+             *
+             * @param eventType The event type identifier to remove the listener from.
+             * @param listener Pointer to the asynchronous listener object to be removed.
+             * @return True if the listener was removed successfully, false otherwise.
+             */
+            virtual bool RemoveAsyncListener(EventType eventType, IAsyncEventListener *listener) = 0;
+
+            // Deferred Event
+
+            /**
+             * @brief Post the given event to the deferred event queue.
+             *
+             * Posted events are dispatched in a batch on the game thread once per frame.
+             * This function is lock-free and can be called from any thread.
+             *
+             * @param event Pointer to the event to be posted. A reference is held until the event is dispatched.
+             * @return True if the event was queued successfully, false otherwise.
+             */
+            virtual bool PostEvent(IEvent *event) = 0;
+
+            /**
+             * @brief Post an event of the specified event type to the deferred event queue.
+             *
+             * @param type The event type identifier.
+             * @return True if the event was queued successfully, false otherwise.
+             */
+            virtual bool PostEvent(EventType type) = 0;
+
+            /**
+             * @brief Post an event with the specified event type name to the deferred event queue.
+             *
+             * @param name The name of the event type.
+             * @return True if the event was queued successfully, false otherwise.
+             */
+            virtual bool PostEvent(const char *name) = 0;
+
+            /**
+             * @brief Set the per-frame coalescing mode of the specified event type.
+             *
+             * Coalescing applies to events posted with PostEvent. Events are grouped by the value at
+             * keyIndex in their data stack, or into a single group if keyIndex is negative.
+             *
+             * @param type The event type identifier.
+             * @param mode The coalescing mode.
+             * @param keyIndex The index of the key in the data stack of the events, or -1 for no key.
+             * @param merge The merge callback, required by EVENT_COALESCE_MERGE.
+             * @param userdata The user data passed to the merge callback.
+             * @return True if the mode was set successfully, false otherwise.
+             */
+            virtual bool SetEventCoalescing(EventType type, EventCoalesceMode mode, int keyIndex = -1,
+                                            EventMergeCallback merge = nullptr, void *userdata = nullptr) = 0;
+
+            /**
+             * @brief Add a batch listener for the specified event type.
+             *
+             * Batch listeners receive the events posted with PostEvent once per frame, after coalescing
+             * and after the ordinary listeners have been called.
+             *
+             * @param eventType The event type identifier to listen for.
+             * @param listener Pointer to the batch listener object to be added.
+             * @return True if the listener was added successfully, false otherwise.
+             */
+            virtual bool AddBatchListener(EventType eventType, IEventBatchListener *listener) = 0;
+
+            /**
+             * @brief Remove a batch listener for the specified event type.
+             *
+             * @param eventType The event type identifier to remove the listener from.
+             * @param listener Pointer to the batch listener object to be removed.
+             * @return True if the listener was removed successfully, false otherwise.
+             */
+            virtual bool RemoveBatchListener(EventType eventType, IEventBatchListener *listener) = 0;
+
+            // Scheduled Event
+
+            /**
+             * @brief Schedule an event of the given type to be sent after a delay.
+             *
+             * Scheduled events are sent on the game thread once per frame, before the mods are updated.
+             * This function can be called from any thread.
+             *
+             * @param type The event type identifier.
+             * @param delay The delay, a delay of 0 is treated as 1.
+             * @param unit The unit of the delay.
+             * @param repeat True to send the event again after every delay until it is cancelled.
+             * @return The timer identifier, or 0 if the event could not be scheduled.
+             */
+            virtual EventTimer ScheduleEvent(EventType type, uint32_t delay, EventTimerUnit unit = EVENT_TIMER_FRAMES,
+                                             bool repeat = false) = 0;
+
+            /**
+             * @brief Schedule the given event to be sent after a delay.
+             *
+             * @param event Pointer to the event to be sent. A reference is held until the timer expires or is cancelled.
+             * @param delay The delay, a delay of 0 is treated as 1.
+             * @param unit The unit of the delay.
+             * @param repeat True to send the event again after every delay until it is cancelled.
+             * @return The timer identifier, or 0 if the event could not be scheduled.
+             */
+            virtual EventTimer ScheduleEvent(IEvent *event, uint32_t delay, EventTimerUnit unit = EVENT_TIMER_FRAMES,
+                                             bool repeat = false) = 0;
+
+            /**
+             * @brief Cancel a scheduled event.
+             *
+             * @param timer The timer identifier returned by ScheduleEvent.
+             * @return True if the timer was pending and has been cancelled, false otherwise.
+             */
+            virtual bool CancelScheduledEvent(EventTimer timer) = 0;
+
+            // Statistics
+
+            /**
+             * @brief Get the counters of the event object pool.
+             *
+             * The pool hit rate is `reused / acquired`.
+             *
+             * @param stats Pointer to the structure receiving the counters.
+             */
+            virtual void GetEventPoolStats(EventPoolStats *stats) const = 0;
+
+            // Methods added after the first release go below, existing vtable slots must not move.
+            // Overloads are grouped together in the vtable by MSVC, so new methods get new names.
+
+            /**
+             * @brief Get the event type identifier associated with the given event type name and its hash.
+             *
+             * Same as GetEventType, without hashing the name. Use BALLOON_EVENT_HASH to compute the hash at compile time.
+             *
+             * @param name The name of the event type.
+             * @param hash The hash of the name computed by HashEventName.
+             * @return The event type identifier.
+             */
+            virtual EventType GetEventTypeByHash(const char *name, uint32_t hash) const = 0;
+
+            /**
+             * @brief Add a listener for the specified event type with the given priority and phase.
+             *
+             * Listeners are called phase by phase, and by descending priority within a phase.
+             * Listeners with equal priority are called in registration order.
+             * AddListener registers listeners with priority 0 in the normal phase.
+             *
+             * @param eventType The event type identifier to listen for.
+             * @param listener Pointer to the listener object to be added.
+             * @param priority The priority of the listener, higher values are called first.
+             * @param phase The dispatch phase of the listener.
+             * @return True if the listener was added successfully, false otherwise.
+             */
+            virtual bool AddListenerEx(EventType eventType, IEventListener *listener, int priority, EventPhase phase = EVENT_PHASE_NORMAL) = 0;
+
+            /**
+             * @brief Add a listener for the specified event name with the given priority and phase.
+             *
+             * @param eventName The name of the event, or the pattern of the events, to listen for.
+             * @param listener Pointer to the listener object to be added.
+             * @param priority The priority of the listener, higher values are called first.
+             * @param phase The dispatch phase of the listener.
+             * @return True if the listener was added successfully, false otherwise.
+             */
+            virtual bool AddListenerEx(const char *eventName, IEventListener *listener, int priority, EventPhase phase = EVENT_PHASE_NORMAL) = 0;
+
+            /**
+             * @brief Add a listener for the specified event type, called only for events whose flag matches.
+             *
+             * The listener is called for an event if (event->GetFlag() & flagMask) == flagValue.
+             * The test is made by the event manager before calling the listener.
+             *
+             * @param eventType The event type identifier to listen for.
+             * @param listener Pointer to the listener object to be added.
+             * @param priority The priority of the listener, higher values are called first.
+             * @param phase The dispatch phase of the listener.
+             * @param flagMask The mask applied to the flag of the events.
+             * @param flagValue The value the masked flag must be equal to.
+             * @return True if the listener was added successfully, false otherwise.
+             */
+            virtual bool AddFilteredListener(EventType eventType, IEventListener *listener, int priority, EventPhase phase,
+                                             int flagMask, int flagValue) = 0;
+
+            /**
+             * @brief Add a listener for the specified event name, called only for events whose flag matches.
+             *
+             * @param eventName The name of the event, or the pattern of the events, to listen for.
+             * @param listener Pointer to the listener object to be added.
+             * @param priority The priority of the listener, higher values are called first.
+             * @param phase The dispatch phase of the listener.
+             * @param flagMask The mask applied to the flag of the events.
+             * @param flagValue The value the masked flag must be equal to.
+             * @return True if the listener was added successfully, false otherwise.
+             */
+            virtual bool AddFilteredListener(const char *eventName, IEventListener *listener, int priority, EventPhase phase,
+                                             int flagMask, int flagValue) = 0;
         };
     }
 }
@@ -0,0 +1,122 @@
+/**
+ * @file IEventProfiler.h
+ * @brief The interface of event dispatch profiler.
+ */
+#ifndef BALLOON_IEVENTPROFILER_H
+#define BALLOON_IEVENTPROFILER_H
+
+#include <cstdint>
+
+#include "Balloon/IEventManager.h"
+
+/**
+ * @brief The number of sub-buckets in each power of two range of a latency histogram.
+ */
+#define EVENT_PROFILER_SUB_BUCKET_COUNT 4
+
+/**
+ * @brief The number of buckets in a latency histogram.
+ */
+#define EVENT_PROFILER_BUCKET_COUNT (40 * EVENT_PROFILER_SUB_BUCKET_COUNT)
+
+namespace balloon {
+    inline namespace v1 {
+        /**
+         * @brief Dispatch statistics of an event type.
+         *
+         * Times are in nanoseconds and include nested sends made by listeners.
+         */
+        struct EventProfile {
+            size_t sendCount;   /**< The number of dispatched events. */
+            uint64_t totalTime; /**< The total time spent in listeners. */
+            uint64_t maxTime;   /**< The longest dispatch of a single event. */
+        };
+
+        /**
+         * @brief Latency statistics of a listener of an event type.
+         *
+         * The histogram is log-linear: each power of two range is split into EVENT_PROFILER_SUB_BUCKET_COUNT
+         * buckets, so percentiles are accurate to about 25% at any scale.
+         */
+        struct EventListenerProfile {
+            IEventListener *listener; /**< The listener. */
+            size_t callCount;         /**< The number of calls. */
+            uint64_t totalTime;       /**< The total time spent in the listener. */
+            uint64_t maxTime;         /**< The longest call. */
+            uint64_t p50;             /**< The upper bound of the median latency. */
+            uint64_t p99;             /**< The upper bound of the 99th percentile latency. */
+            uint32_t buckets[EVENT_PROFILER_BUCKET_COUNT]; /**< The latency histogram. */
+        };
+
+        /**
+         * @brief The interface of event dispatch profiler.
+         *
+         * The profiler is disabled by default, in which case dispatch only pays for a single flag check.
+         */
+        class IEventProfiler {
+        public:
+            /**
+             * @brief Enable or disable profiling.
+             * @param enabled True to enable profiling, false to disable it.
+             */
+            virtual void SetEnabled(bool enabled) = 0;
+
+            /**
+             * @brief Check if profiling is enabled.
+             * @return True if profiling is enabled, false otherwise.
+             */
+            virtual bool IsEnabled() const = 0;
+
+            /**
+             * @brief Discard all recorded statistics.
+             */
+            virtual void Reset() = 0;
+
+            /**
+             * @brief Get the dispatch statistics of an event type.
+             *
+             * @param type The event type identifier.
+             * @param profile Pointer to the structure receiving the statistics.
+             * @return True if statistics were recorded for the type, false otherwise.
+             */
+            virtual bool GetEventProfile(EventType type, EventProfile *profile) const = 0;
+
+            /**
+             * @brief Get the number of profiled listeners of an event type.
+             *
+             * @param type The event type identifier.
+             * @return The number of profiled listeners.
+             */
+            virtual size_t GetListenerProfileCount(EventType type) const = 0;
+
+            /**
+             * @brief Get the latency statistics of a listener of an event type.
+             *
+             * @param type The event type identifier.
+             * @param index The index of the listener, less than GetListenerProfileCount.
+             * @param profile Pointer to the structure receiving the statistics.
+             * @return True if the statistics were retrieved successfully, false otherwise.
+             */
+            virtual bool GetListenerProfile(EventType type, size_t index, EventListenerProfile *profile) const = 0;
+
+            /**
+             * @brief Set the interval of the periodic dump to the logger.
+             * @param frames The number of frames between dumps, 0 disables the periodic dump.
+             */
+            virtual void SetDumpInterval(uint32_t frames) = 0;
+
+            /**
+             * @brief Get the interval of the periodic dump to the logger.
+             * @return The number of frames between dumps, 0 if the periodic dump is disabled.
+             */
+            virtual uint32_t GetDumpInterval() const = 0;
+
+            /**
+             * @brief Write the recorded statistics to the logger.
+             */
+            virtual void Dump() const = 0;
+        };
+    }
+}
+
+#endif // BALLOON_IEVENTPROFILER_H
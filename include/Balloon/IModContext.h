@@ -11,6 +11,7 @@
 #include "Balloon/IDataShare.h"
 #include "Balloon/IEventManager.h"
 #include "Balloon/IDataStack.h"
+#include "Balloon/IDataStackRing.h"
 #include "Balloon/IWeakRefFlag.h"
 #include "Balloon/ILogger.h"
 #include "Balloon/IConfig.h"
@@ -157,6 +158,24 @@ namespace balloon {
                 return static_cast<IDataStack *>(CreateObject(nullptr, "DataStack", nullptr, 1));
             }
 
+            /**
+             * @brief Create a data stack object with the given parameters.
+             * @param desc The parameters of the data stack, nullptr for the defaults.
+             * @return A pointer to the created data stack object.
+             */
+            IDataStack *CreateDataStack(DataStackDesc *desc) const {
+                return static_cast<IDataStack *>(CreateObject(desc, "DataStack", nullptr, 2));
+            }
+
+            /**
+             * @brief Create a data stack ring object.
+             * @param desc The parameters of the ring, nullptr for the defaults.
+             * @return A pointer to the created data stack ring object.
+             */
+            IDataStackRing *CreateDataStackRing(DataStackRingDesc *desc = nullptr) const {
+                return static_cast<IDataStackRing *>(CreateObject(desc, "DataStackRing", nullptr, 1));
+            }
+
             /**
              * @brief Create a weak reference flag object.
              * @return A pointer to the created weak reference flag object.
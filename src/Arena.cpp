@@ -0,0 +1,85 @@
+#include "Arena.h"
+
+#include <cstdlib>
+
+using namespace balloon;
+
+namespace {
+    size_t AlignUp(size_t size, size_t alignment) {
+        return (size + alignment - 1) & ~(alignment - 1);
+    }
+}
+
+Arena::Arena(size_t chunkSize) : m_ChunkSize(chunkSize != 0 ? chunkSize : DEFAULT_CHUNK_SIZE) {}
+
+Arena::~Arena() {
+    FreeChunks();
+}
+
+void *Arena::Allocate(size_t size) {
+    size = AlignUp(size != 0 ? size : 1, ALIGNMENT);
+    if (static_cast<size_t>(m_End - m_Cursor) < size) {
+        // Grow geometrically so long rounds settle on a few chunks.
+        size_t chunkSize = m_Capacity > m_ChunkSize ? m_Capacity : m_ChunkSize;
+        if (!AddChunk(chunkSize > size ? chunkSize : size))
+            return nullptr;
+    }
+
+    void *ptr = m_Cursor;
+    m_Cursor += size;
+    m_Used += size;
+    return ptr;
+}
+
+void Arena::Reserve(size_t size) {
+    size = AlignUp(size, ALIGNMENT);
+    if (static_cast<size_t>(m_End - m_Cursor) >= size)
+        return;
+
+    if (m_Used == 0)
+        FreeChunks();
+    AddChunk(size);
+}
+
+void Arena::Reset() {
+    if (m_Chunks && m_Chunks->next) {
+        // Several chunks were needed, replace them by one block large enough for the whole round.
+        size_t capacity = m_Capacity;
+        FreeChunks();
+        AddChunk(capacity);
+    } else if (m_Chunks) {
+        m_Cursor = reinterpret_cast<char *>(m_Chunks) + AlignUp(sizeof(Chunk), ALIGNMENT);
+    }
+    m_Used = 0;
+}
+
+bool Arena::AddChunk(size_t size) {
+    const size_t header = AlignUp(sizeof(Chunk), ALIGNMENT);
+    auto *chunk = static_cast<Chunk *>(malloc(header + size));
+    if (!chunk)
+        return false;
+
+    chunk->next = m_Chunks;
+    chunk->size = size;
+    m_Chunks = chunk;
+    m_Capacity += size;
+
+    m_Cursor = reinterpret_cast<char *>(chunk) + header;
+    m_End = m_Cursor + size;
+    return true;
+}
+
+void Arena::FreeChunks() {
+    Chunk *chunk = m_Chunks;
+    while (chunk) {
+        Chunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+
+    m_Chunks = nullptr;
+    m_Cursor = nullptr;
+    m_End = nullptr;
+    m_Capacity = 0;
+    m_Used = 0;
+}
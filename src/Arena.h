@@ -0,0 +1,54 @@
+#ifndef BALLOON_ARENA_H
+#define BALLOON_ARENA_H
+
+#include <cstddef>
+
+namespace balloon {
+    /**
+     * @brief Bump pointer allocator releasing all of its allocations at once.
+     *
+     * Memory is carved from chunks which are only returned on Reset or destruction.
+     * Reset folds the chunks of a busy round into a single one, so the steady state
+     * serves every allocation from one block.
+     */
+    class Arena final {
+    public:
+        static constexpr size_t DEFAULT_CHUNK_SIZE = 1024;
+        static constexpr size_t ALIGNMENT = 8;
+
+        explicit Arena(size_t chunkSize = DEFAULT_CHUNK_SIZE);
+
+        Arena(const Arena &rhs) = delete;
+        Arena(Arena &&rhs) noexcept = delete;
+
+        ~Arena();
+
+        Arena &operator=(const Arena &rhs) = delete;
+        Arena &operator=(Arena &&rhs) noexcept = delete;
+
+        void *Allocate(size_t size);
+        void Reserve(size_t size);
+        void Reset();
+
+        size_t Capacity() const { return m_Capacity; }
+        size_t Used() const { return m_Used; }
+
+    private:
+        struct Chunk {
+            Chunk *next;
+            size_t size;
+        };
+
+        bool AddChunk(size_t size);
+        void FreeChunks();
+
+        Chunk *m_Chunks = nullptr;
+        char *m_Cursor = nullptr;
+        char *m_End = nullptr;
+        size_t m_ChunkSize;
+        size_t m_Capacity = 0;
+        size_t m_Used = 0;
+    };
+}
+
+#endif // BALLOON_ARENA_H
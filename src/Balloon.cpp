@@ -7,7 +7,10 @@
 #include "FileSystem.h"
 #include "DataShare.h"
 #include "EventManager.h"
+#include "EventProfiler.h"
+#include "EventRecorder.h"
 #include "DataStack.h"
+#include "DataStackRing.h"
 #include "WeakRefFlag.h"
 #include "StringUtils.h"
 #include "PathUtils.h"
@@ -62,6 +65,9 @@ void Balloon::Shutdown() {
     if (IsInited()) {
         DisconnectMods();
         ShutdownMods();
+        EventRecorder::GetInstance().StopReplay();
+        EventRecorder::GetInstance().StopRecording();
+        EventManager::GetInstance().Reset();
         UnloadMods();
 
         m_Context = nullptr;
@@ -277,6 +283,11 @@ void Balloon::DisconnectMods() {
 }
 
 void Balloon::OnProcess() {
+    EventRecorder::GetInstance().Update();
+    EventManager::GetInstance().DispatchEvents();
+    EventManager::GetInstance().UpdateTimers();
+    EventProfiler::GetInstance().Update();
+
     for (auto *mod: m_ModsOnUpdate) {
         mod->OnUpdate();
     }
@@ -566,10 +577,15 @@ void Balloon::RegisterBuiltinInterfaces() {
     m_Context->RegisterInterface(&FileSystem::GetInstance(), "fs", 1);
     m_Context->RegisterInterface(&DataShare::GetInstance(), "ds", 1);
     m_Context->RegisterInterface(&EventManager::GetInstance(), "em", 1);
+    m_Context->RegisterInterface(&EventProfiler::GetInstance(), "ep", 1);
+    m_Context->RegisterInterface(&EventRecorder::GetInstance(), "ej", 1);
 }
 
 void Balloon::RegisterBuiltinFactories() {
     m_Context->RegisterFactory(&DataStackFactory::GetInstance(), "DataStack", 1);
+    m_Context->RegisterFactory(&DataStackDescFactory::GetInstance(), "DataStack", 2);
+    m_Context->RegisterFactory(&DataStackPool::GetInstance(), "DataStackPool", 1);
+    m_Context->RegisterFactory(&DataStackRingFactory::GetInstance(), "DataStackRing", 1);
     m_Context->RegisterFactory(&WeakRefFlagFactory::GetInstance(), "WeakRefFlag", 1);
 }
 
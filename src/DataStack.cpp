@@ -1,22 +1,341 @@
 #include "DataStack.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <iterator>
+#include <limits>
 
 using namespace balloon;
 
+namespace {
+    // Members of caller structures are not necessarily aligned, go through memcpy.
+    template <typename T>
+    T ReadValue(const void *src) {
+        T value;
+        memcpy(&value, src, sizeof(T));
+        return value;
+    }
+
+    template <typename T>
+    void WriteValue(void *dst, T value) {
+        memcpy(dst, &value, sizeof(T));
+    }
+
+    size_t GetTagSize(uint8_t tag) {
+        switch (tag & VAR_TYPE_MASK) {
+            case VAR_TYPE_BOOL:
+                return sizeof(bool);
+            case VAR_TYPE_CHAR:
+                return sizeof(char);
+            case VAR_TYPE_NUM:
+                switch (tag & VAR_SUBTYPE_MASK) {
+                    case VAR_SUBTYPE_UINT8:
+                    case VAR_SUBTYPE_INT8:
+                        return 1;
+                    case VAR_SUBTYPE_UINT16:
+                    case VAR_SUBTYPE_INT16:
+                        return 2;
+                    case VAR_SUBTYPE_UINT32:
+                    case VAR_SUBTYPE_INT32:
+                    case VAR_SUBTYPE_FLOAT32:
+                        return 4;
+                    case VAR_SUBTYPE_UINT64:
+                    case VAR_SUBTYPE_INT64:
+                    case VAR_SUBTYPE_FLOAT64:
+                        return 8;
+                    default:
+                        return 0;
+                }
+            case VAR_TYPE_STR:
+                return sizeof(const char *);
+            case VAR_TYPE_PTR:
+                return sizeof(void *);
+            default:
+                return 0;
+        }
+    }
+
+    // A number widened to the representation that holds its subtype exactly.
+    struct Number {
+        enum Kind { SIGNED, UNSIGNED, FLOAT } kind;
+        int64_t i;
+        uint64_t u;
+        double f;
+    };
+
+    Number ReadNumber(const Variant &cell) {
+        switch (cell.GetSubtype()) {
+            case VAR_SUBTYPE_UINT8:
+                return {Number::UNSIGNED, 0, cell.GetUint8(), 0.0};
+            case VAR_SUBTYPE_INT8:
+                return {Number::SIGNED, cell.GetInt8(), 0, 0.0};
+            case VAR_SUBTYPE_UINT16:
+                return {Number::UNSIGNED, 0, cell.GetUint16(), 0.0};
+            case VAR_SUBTYPE_INT16:
+                return {Number::SIGNED, cell.GetInt16(), 0, 0.0};
+            case VAR_SUBTYPE_UINT32:
+                return {Number::UNSIGNED, 0, cell.GetUint32(), 0.0};
+            case VAR_SUBTYPE_INT32:
+                return {Number::SIGNED, cell.GetInt32(), 0, 0.0};
+            case VAR_SUBTYPE_UINT64:
+                return {Number::UNSIGNED, 0, cell.GetUint64(), 0.0};
+            case VAR_SUBTYPE_INT64:
+                return {Number::SIGNED, cell.GetInt64(), 0, 0.0};
+            case VAR_SUBTYPE_FLOAT32:
+                return {Number::FLOAT, 0, 0, cell.GetFloat32()};
+            default:
+                return {Number::FLOAT, 0, 0, cell.GetFloat64()};
+        }
+    }
+
+    template <typename T>
+    bool NarrowInteger(const Number &number, void *dst) {
+        typedef std::numeric_limits<T> Limits;
+        switch (number.kind) {
+            case Number::SIGNED:
+                if (number.i < 0 ? number.i < static_cast<int64_t>(Limits::min())
+                                 : static_cast<uint64_t>(number.i) > static_cast<uint64_t>(Limits::max()))
+                    return false;
+                WriteValue(dst, static_cast<T>(number.i));
+                return true;
+            case Number::UNSIGNED:
+                if (number.u > static_cast<uint64_t>(Limits::max()))
+                    return false;
+                WriteValue(dst, static_cast<T>(number.u));
+                return true;
+            default: {
+                // The bounds are powers of two, exact in a double. NaN fails both comparisons.
+                const double upper = std::ldexp(1.0, Limits::digits);
+                const double lower = Limits::is_signed ? -upper : 0.0;
+                if (!(number.f >= lower && number.f < upper) || std::trunc(number.f) != number.f)
+                    return false;
+                WriteValue(dst, static_cast<T>(number.f));
+                return true;
+            }
+        }
+    }
+
+    template <typename T>
+    bool NarrowFloat(const Number &number, void *dst) {
+        T value;
+        switch (number.kind) {
+            case Number::SIGNED:
+                // Large integers round to the nearest representable value, only round trips are exact.
+                value = static_cast<T>(number.i);
+                if (static_cast<double>(value) >= 9223372036854775808.0 || static_cast<int64_t>(value) != number.i)
+                    return false;
+                break;
+            case Number::UNSIGNED:
+                value = static_cast<T>(number.u);
+                if (static_cast<double>(value) >= 18446744073709551616.0 || static_cast<uint64_t>(value) != number.u)
+                    return false;
+                break;
+            default:
+                if (std::isfinite(number.f) && std::fabs(number.f) > static_cast<double>(std::numeric_limits<T>::max()))
+                    return false;
+                value = static_cast<T>(number.f);
+                if (std::isfinite(number.f) && static_cast<double>(value) != number.f)
+                    return false;
+                break;
+        }
+        WriteValue(dst, value);
+        return true;
+    }
+
+    // Converts a cell to another tag when nothing is lost, see IDataStack::GetValue.
+    bool ConvertValue(const Variant &cell, uint8_t tag, void *dst, size_t size) {
+        if (size != GetTagSize(tag))
+            return false;
+
+        switch (tag & VAR_TYPE_MASK) {
+            case VAR_TYPE_BOOL:
+                if (!cell.IsBool())
+                    return false;
+                WriteValue(dst, cell.GetBool());
+                return true;
+            case VAR_TYPE_CHAR:
+                if (!cell.IsChar())
+                    return false;
+                WriteValue(dst, cell.GetChar());
+                return true;
+            case VAR_TYPE_NUM: {
+                if (!cell.IsNum())
+                    return false;
+                const Number number = ReadNumber(cell);
+                switch (tag & VAR_SUBTYPE_MASK) {
+                    case VAR_SUBTYPE_UINT8:
+                        return NarrowInteger<uint8_t>(number, dst);
+                    case VAR_SUBTYPE_INT8:
+                        return NarrowInteger<int8_t>(number, dst);
+                    case VAR_SUBTYPE_UINT16:
+                        return NarrowInteger<uint16_t>(number, dst);
+                    case VAR_SUBTYPE_INT16:
+                        return NarrowInteger<int16_t>(number, dst);
+                    case VAR_SUBTYPE_UINT32:
+                        return NarrowInteger<uint32_t>(number, dst);
+                    case VAR_SUBTYPE_INT32:
+                        return NarrowInteger<int32_t>(number, dst);
+                    case VAR_SUBTYPE_UINT64:
+                        return NarrowInteger<uint64_t>(number, dst);
+                    case VAR_SUBTYPE_INT64:
+                        return NarrowInteger<int64_t>(number, dst);
+                    case VAR_SUBTYPE_FLOAT32:
+                        return NarrowFloat<float>(number, dst);
+                    case VAR_SUBTYPE_FLOAT64:
+                        return NarrowFloat<double>(number, dst);
+                    default:
+                        return false;
+                }
+            }
+            case VAR_TYPE_STR:
+                // Inline strings are not held by the value and never take the exact path.
+                if (!cell.IsString())
+                    return false;
+                WriteValue(dst, cell.GetString());
+                return true;
+            case VAR_TYPE_PTR:
+                if (!cell.IsPtr())
+                    return false;
+                WriteValue(dst, cell.GetPtr());
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    // Serialized layout, integers are little-endian:
+    // - Header: "BDST", u16 version, u16 reserved, u32 total size, u32 value count, u32 cursor count.
+    // - Cursors: u32 each.
+    // - Values: u8 tag, then u8 for chars, the natural width for numbers,
+    //   u32 length, bytes and terminator for strings, u32 length and bytes for buffers.
+    const uint8_t SERIAL_MAGIC[4] = {'B', 'D', 'S', 'T'};
+
+    // Magic, version, reserved, total size, value count and cursor count.
+    constexpr size_t SERIAL_HEADER_SIZE = 20;
+
+    // Counts the bytes only when there is no destination, so the same code sizes and writes.
+    class SerialWriter {
+    public:
+        explicit SerialWriter(uint8_t *data) : m_Data(data) {}
+
+        void Put(uint64_t value, size_t size) {
+            if (m_Data) {
+                for (size_t i = 0; i < size; ++i)
+                    m_Data[m_Size + i] = static_cast<uint8_t>(value >> (i * 8));
+            }
+            m_Size += size;
+        }
+
+        void PutBytes(const void *data, size_t size) {
+            if (m_Data && size != 0)
+                memcpy(m_Data + m_Size, data, size);
+            m_Size += size;
+        }
+
+        size_t GetSize() const { return m_Size; }
+
+    private:
+        uint8_t *m_Data;
+        size_t m_Size = 0;
+    };
+
+    class SerialReader {
+    public:
+        SerialReader(const uint8_t *data, size_t size) : m_Data(data), m_End(data + size) {}
+
+        bool Get(uint64_t &value, size_t size) {
+            if (Remaining() < size)
+                return false;
+
+            value = 0;
+            for (size_t i = 0; i < size; ++i)
+                value |= static_cast<uint64_t>(m_Data[i]) << (i * 8);
+            m_Data += size;
+            return true;
+        }
+
+        const uint8_t *GetBytes(uint64_t size) {
+            if (Remaining() < size)
+                return nullptr;
+
+            const uint8_t *data = m_Data;
+            m_Data += size;
+            return data;
+        }
+
+        size_t Remaining() const { return static_cast<size_t>(m_End - m_Data); }
+
+    private:
+        const uint8_t *m_Data;
+        const uint8_t *m_End;
+    };
+
+    // Numbers travel as little-endian integers of their natural width.
+    uint64_t ToBits(const uint8_t *bytes, size_t width) {
+        switch (width) {
+            case 1:
+                return bytes[0];
+            case 2:
+                return ReadValue<uint16_t>(bytes);
+            case 4:
+                return ReadValue<uint32_t>(bytes);
+            default:
+                return ReadValue<uint64_t>(bytes);
+        }
+    }
+
+    void FromBits(uint64_t bits, size_t width, uint8_t *bytes) {
+        switch (width) {
+            case 1:
+                bytes[0] = static_cast<uint8_t>(bits);
+                break;
+            case 2:
+                WriteValue(bytes, static_cast<uint16_t>(bits));
+                break;
+            case 4:
+                WriteValue(bytes, static_cast<uint32_t>(bits));
+                break;
+            default:
+                WriteValue(bytes, bits);
+                break;
+        }
+    }
+}
+
 std::mutex DataStack::m_RWLock;
 
+DataStack::Storage::~Storage() {
+    values.clear();
+    delete arena;
+}
+
 DataStack::DataStack() {
     m_Cursors.push_back(0);
+    m_Storage = CreateStorage();
 }
 
-DataStack::DataStack(const DataStack &rhs) : m_Data(rhs.m_Data), m_Cursors(rhs.m_Cursors) {}
+DataStack::DataStack(const DataStackDesc &desc) : m_Flags(desc.flags), m_ArenaSize(desc.arenaSize) {
+    m_Cursors.push_back(0);
+    m_Storage = CreateStorage();
+    if (desc.capacity != 0)
+        Reserve(desc.capacity);
+}
+
+DataStack::DataStack(const DataStack &rhs)
+    : m_Cursors(rhs.m_Cursors), m_Storage(rhs.m_Storage), m_Flags(rhs.m_Flags), m_ArenaSize(rhs.m_ArenaSize) {
+    // The values are shared until one of the stacks modifies them.
+    m_Storage->refs.AddRef();
+}
 
 DataStack::~DataStack() {
     if (m_WeakRefFlag) {
         m_WeakRefFlag->Release();
         m_WeakRefFlag = nullptr;
     }
+
+    ReleaseStorage(m_Storage);
 }
 
 int DataStack::AddRef() const {
@@ -29,7 +348,10 @@ int DataStack::Release() const {
         if (m_WeakRefFlag)
             m_WeakRefFlag->Set(true);
         std::atomic_thread_fence(std::memory_order_acquire);
-        delete const_cast<DataStack *>(this);
+        if (m_Pool)
+            m_Pool->Recycle(const_cast<DataStack *>(this));
+        else
+            delete const_cast<DataStack *>(this);
     }
     return r;
 }
@@ -45,35 +367,48 @@ IWeakRefFlag *DataStack::GetWeakRefFlag() const {
 }
 
 void DataStack::Clear() {
-    m_Data.clear();
+    if (IsShared()) {
+        ReleaseStorage(m_Storage);
+        m_Storage = CreateStorage();
+    } else {
+        m_Storage->values.clear();
+        if (m_Storage->arena)
+            m_Storage->arena->Reset();
+    }
+    m_Cursors.clear();
+    m_Cursors.push_back(0);
 }
 
 bool DataStack::Empty() const {
-    return m_Data.empty();
+    return m_Storage->values.empty();
 }
 
 size_t DataStack::Size() const {
-    return m_Data.size();
+    return m_Storage->values.size();
 }
 
 size_t DataStack::Capacity() const {
-    return m_Data.capacity();
+    return m_Storage->values.capacity();
 }
 
 void DataStack::Reserve(size_t cap) {
-    m_Data.reserve(cap);
+    Detach();
+    if (m_Storage->arena && cap > m_Storage->values.size())
+        m_Storage->arena->Reserve((cap - m_Storage->values.size()) * ARENA_BYTES_PER_VALUE);
+    m_Storage->values.reserve(cap);
 }
 
 void DataStack::Shrink() {
-    m_Data.shrink_to_fit();
+    Detach();
+    m_Storage->values.shrink_to_fit();
 }
 
 size_t DataStack::CursorTo(int offset) const {
     size_t index = m_Cursors.back() + offset;
     if (index <= 0)
         return 0;
-    else if (index >= m_Data.size())
-        return m_Data.size() - 1;
+    else if (index >= m_Storage->values.size())
+        return m_Storage->values.size() - 1;
     else
         return index;
 }
@@ -83,7 +418,7 @@ size_t DataStack::GetCursor() const {
 }
 
 bool DataStack::SetCursor(size_t index) {
-    if (index >= m_Data.size())
+    if (index >= m_Storage->values.size())
         return false;
 
     m_Cursors.back() = index;
@@ -99,182 +434,201 @@ void DataStack::PopCursor() {
 }
 
 void DataStack::Push() {
-    m_Data.emplace_back();
+    Detach();
+    m_Storage->values.emplace_back();
 }
 
 void DataStack::Pop() {
-    m_Data.pop_back();
+    Detach();
+    m_Storage->values.pop_back();
 }
 
 uint8_t DataStack::GetTag(size_t index) const {
-    assert(index < m_Data.size());
-    return m_Data[index].GetTag();
+    assert(index < m_Storage->values.size());
+    return m_Storage->values[index].GetTag();
 }
 
 uint8_t DataStack::GetType(size_t index) const {
-    assert(index < m_Data.size());
-    return m_Data[index].GetType();
+    assert(index < m_Storage->values.size());
+    return m_Storage->values[index].GetType();
 }
 
 uint8_t DataStack::GetSubtype(size_t index) const {
-    assert(index < m_Data.size());
-    return m_Data[index].GetSubtype();
+    assert(index < m_Storage->values.size());
+    return m_Storage->values[index].GetSubtype();
 }
 
 size_t DataStack::GetSize(size_t index) const {
-    assert(index < m_Data.size());
-    return m_Data[index].GetSize();
+    assert(index < m_Storage->values.size());
+    return m_Storage->values[index].GetSize();
 }
 
 bool DataStack::GetBool(size_t index) const {
-    assert(index < m_Data.size());
-    return m_Data[index].GetBool();
+    assert(index < m_Storage->values.size());
+    return m_Storage->values[index].GetBool();
 }
 
 char DataStack::GetChar(size_t index) const {
-    assert(index < m_Data.size());
-    return m_Data[index].GetChar();
+    assert(index < m_Storage->values.size());
+    return m_Storage->values[index].GetChar();
 }
 
 uint8_t DataStack::GetUint8(size_t index) const {
-    assert(index < m_Data.size());
-    return m_Data[index].GetUint8();
+    assert(index < m_Storage->values.size());
+    return m_Storage->values[index].GetUint8();
 }
 
 int8_t DataStack::GetInt8(size_t index) const {
-    assert(index < m_Data.size());
-    return m_Data[index].GetInt8();
+    assert(index < m_Storage->values.size());
+    return m_Storage->values[index].GetInt8();
 }
 
 uint16_t DataStack::GetUint16(size_t index) const {
-    assert(index < m_Data.size());
-    return m_Data[index].GetUint16();
+    assert(index < m_Storage->values.size());
+    return m_Storage->values[index].GetUint16();
 }
 
 int16_t DataStack::GetInt16(size_t index) const {
-    assert(index < m_Data.size());
-    return m_Data[index].GetInt16();
+    assert(index < m_Storage->values.size());
+    return m_Storage->values[index].GetInt16();
 }
 
 uint32_t DataStack::GetUint32(size_t index) const {
-    assert(index < m_Data.size());
-    return m_Data[index].GetUint32();
+    assert(index < m_Storage->values.size());
+    return m_Storage->values[index].GetUint32();
 }
 
 int32_t DataStack::GetInt32(size_t index) const {
-    assert(index < m_Data.size());
-    return m_Data[index].GetInt32();
+    assert(index < m_Storage->values.size());
+    return m_Storage->values[index].GetInt32();
 }
 
 uint64_t DataStack::GetUint64(size_t index) const {
-    assert(index < m_Data.size());
-    return m_Data[index].GetUint64();
+    assert(index < m_Storage->values.size());
+    return m_Storage->values[index].GetUint64();
 }
 
 int64_t DataStack::GetInt64(size_t index) const {
-    assert(index < m_Data.size());
-    return m_Data[index].GetInt64();
+    assert(index < m_Storage->values.size());
+    return m_Storage->values[index].GetInt64();
 }
 
 float DataStack::GetFloat32(size_t index) const {
-    assert(index < m_Data.size());
-    return m_Data[index].GetFloat32();
+    assert(index < m_Storage->values.size());
+    return m_Storage->values[index].GetFloat32();
 }
 
 double DataStack::GetFloat64(size_t index) const {
-    assert(index < m_Data.size());
-    return m_Data[index].GetFloat64();
+    assert(index < m_Storage->values.size());
+    return m_Storage->values[index].GetFloat64();
 }
 
 const char *DataStack::GetString(size_t index) const {
-    assert(index < m_Data.size());
-    return m_Data[index].GetString();
+    assert(index < m_Storage->values.size());
+    return m_Storage->values[index].GetString();
 }
 
 const void *DataStack::GetBuffer(size_t index, size_t *size) const {
-    assert(index < m_Data.size());
-    return m_Data[index].GetBuffer();
+    assert(index < m_Storage->values.size());
+    if (size)
+        *size = m_Storage->values[index].GetSize();
+    return m_Storage->values[index].GetBuffer();
 }
 
 void *DataStack::GetPtr(size_t index) const {
-    assert(index < m_Data.size());
-    return m_Data[index].GetPtr();
+    assert(index < m_Storage->values.size());
+    return m_Storage->values[index].GetPtr();
 }
 
 void DataStack::SetValue(size_t index, bool value) {
-    assert(index < m_Data.size());
-    m_Data[index] = value;
+    assert(index < m_Storage->values.size());
+    Detach();
+    m_Storage->values[index] = value;
 }
 
 void DataStack::SetValue(size_t index, char value) {
-    assert(index < m_Data.size());
-    m_Data[index] = value;
+    assert(index < m_Storage->values.size());
+    Detach();
+    m_Storage->values[index] = value;
 }
 
 void DataStack::SetValue(size_t index, uint8_t value) {
-    assert(index < m_Data.size());
-    m_Data[index] = value;
+    assert(index < m_Storage->values.size());
+    Detach();
+    m_Storage->values[index] = value;
 }
 
 void DataStack::SetValue(size_t index, int8_t value) {
-    assert(index < m_Data.size());
-    m_Data[index] = value;
+    assert(index < m_Storage->values.size());
+    Detach();
+    m_Storage->values[index] = value;
 }
 
 void DataStack::SetValue(size_t index, uint16_t value) {
-    assert(index < m_Data.size());
-    m_Data[index] = value;
+    assert(index < m_Storage->values.size());
+    Detach();
+    m_Storage->values[index] = value;
 }
 
 void DataStack::SetValue(size_t index, int16_t value) {
-    assert(index < m_Data.size());
-    m_Data[index] = value;
+    assert(index < m_Storage->values.size());
+    Detach();
+    m_Storage->values[index] = value;
 }
 
 void DataStack::SetValue(size_t index, uint32_t value) {
-    assert(index < m_Data.size());
-    m_Data[index] = value;
+    assert(index < m_Storage->values.size());
+    Detach();
+    m_Storage->values[index] = value;
 }
 
 void DataStack::SetValue(size_t index, int32_t value) {
-    assert(index < m_Data.size());
-    m_Data[index] = value;
+    assert(index < m_Storage->values.size());
+    Detach();
+    m_Storage->values[index] = value;
 }
 
 void DataStack::SetValue(size_t index, uint64_t value) {
-    assert(index < m_Data.size());
-    m_Data[index] = value;
+    assert(index < m_Storage->values.size());
+    Detach();
+    m_Storage->values[index] = value;
 }
 
 void DataStack::SetValue(size_t index, int64_t value) {
-    assert(index < m_Data.size());
-    m_Data[index] = value;
+    assert(index < m_Storage->values.size());
+    Detach();
+    m_Storage->values[index] = value;
 }
 
 void DataStack::SetValue(size_t index, float value) {
-    assert(index < m_Data.size());
-    m_Data[index] = value;
+    assert(index < m_Storage->values.size());
+    Detach();
+    m_Storage->values[index] = value;
 }
 
 void DataStack::SetValue(size_t index, double value) {
-    assert(index < m_Data.size());
-    m_Data[index] = value;
+    assert(index < m_Storage->values.size());
+    Detach();
+    m_Storage->values[index] = value;
 }
 
 void DataStack::SetValue(size_t index, const void *buf, size_t size) {
-    assert(index < m_Data.size());
-    m_Data[index].SetBuffer(buf, size);
+    assert(index < m_Storage->values.size());
+    Detach();
+    m_Storage->values[index].SetBuffer(buf, size, m_Storage->arena);
 }
 
 void DataStack::SetValue(size_t index, void *ptr) {
-    assert(index < m_Data.size());
-    m_Data[index] = ptr;
+    assert(index < m_Storage->values.size());
+    Detach();
+    m_Storage->values[index] = ptr;
 }
 
 void DataStack::Swap(size_t index1, size_t index2) {
-    assert(index1 < m_Data.size());
-    assert(index2 < m_Data.size());
-    std::swap(m_Data[index1], m_Data[index2]);
+    Detach();
+    assert(index1 < m_Storage->values.size());
+    assert(index2 < m_Storage->values.size());
+    std::swap(m_Storage->values[index1], m_Storage->values[index2]);
 }
 
 bool DataStack::Copy(const IDataStack *other) {
@@ -282,7 +636,12 @@ bool DataStack::Copy(const IDataStack *other) {
         return false;
 
     const auto *ds = reinterpret_cast<const DataStack *>(other);
-    m_Data = ds->m_Data;
+    if (ds == this)
+        return true;
+
+    ds->m_Storage->refs.AddRef();
+    ReleaseStorage(m_Storage);
+    m_Storage = ds->m_Storage;
     m_Cursors = ds->m_Cursors;
     return true;
 }
@@ -296,14 +655,13 @@ bool DataStack::Merge(const IDataStack *other) {
         return false;
 
     const auto *ds = reinterpret_cast<const DataStack *>(other);
+    Detach();
 
     for (auto cursor: ds->m_Cursors) {
-        m_Cursors.push_back(cursor + (m_Data.size() - 1));
+        m_Cursors.push_back(cursor + (m_Storage->values.size() - 1));
     }
 
-    for (auto &data: ds->m_Data) {
-        m_Data.emplace_back(data);
-    }
+    AppendValues(*ds);
     return true;
 }
 
@@ -316,14 +674,450 @@ IDataStack *DataStack::Separate() {
         return ret;
     }
 
-    auto *ds = new DataStack;
-    std::copy(m_Data.begin() + cursor, m_Data.end(), ds->m_Data.begin());
-    m_Data.erase(m_Data.begin() + cursor, m_Data.end());
+    DataStackDesc desc = {m_Flags, 0, m_ArenaSize};
+    auto *ds = new DataStack(desc);
+    std::vector<Variant> &tail = ds->m_Storage->values;
+    if (m_Storage->arena || IsShared()) {
+        // Arena payloads and shared values stay here, the tail is copied.
+        tail.resize(m_Storage->values.size() - cursor);
+        for (size_t i = cursor; i < m_Storage->values.size(); ++i)
+            tail[i - cursor].Assign(m_Storage->values[i], ds->m_Storage->arena);
+    } else {
+        tail.assign(std::make_move_iterator(m_Storage->values.begin() + cursor), std::make_move_iterator(m_Storage->values.end()));
+    }
+
+    Detach();
+    m_Storage->values.erase(m_Storage->values.begin() + cursor, m_Storage->values.end());
     m_Cursors.clear();
     m_Cursors.push_back(0);
     return ds;
 }
 
+void DataStack::AppendValues(const DataStack &other) {
+    std::vector<Variant> &values = m_Storage->values;
+    const size_t count = other.m_Storage->values.size();
+
+    // Growing may move the source when both stacks share the storage, so index instead of iterating.
+    size_t offset = values.size();
+    values.resize(offset + count);
+    const std::vector<Variant> &source = other.m_Storage->values;
+    for (size_t i = 0; i < count; ++i)
+        values[offset + i].Assign(source[i], m_Storage->arena);
+}
+
+void DataStack::Configure(const DataStackDesc &desc) {
+    if (desc.flags != m_Flags || desc.arenaSize != m_ArenaSize) {
+        m_Flags = desc.flags;
+        m_ArenaSize = desc.arenaSize;
+        ReleaseStorage(m_Storage);
+        m_Storage = CreateStorage();
+    }
+    if (desc.capacity != 0)
+        Reserve(desc.capacity);
+}
+
+void DataStack::Recycle() {
+    Clear();
+    // The flag of this life has been set on release, the next life gets a new one.
+    if (m_WeakRefFlag) {
+        m_WeakRefFlag->Release();
+        m_WeakRefFlag = nullptr;
+    }
+}
+
+size_t DataStack::GetRetainedBytes() const {
+    size_t bytes = sizeof(DataStack) + m_Storage->values.capacity() * sizeof(Variant) + m_Cursors.capacity() * sizeof(size_t);
+    if (m_Storage->arena)
+        bytes += m_Storage->arena->Capacity();
+    return bytes;
+}
+
+DataStack::Storage *DataStack::CreateStorage() const {
+    auto *storage = new Storage;
+    if (m_Flags & DATA_STACK_ARENA)
+        storage->arena = new Arena(m_ArenaSize);
+    return storage;
+}
+
+void DataStack::ReleaseStorage(Storage *storage) {
+    if (storage->refs.Release() == 0) {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        delete storage;
+    }
+}
+
+bool DataStack::IsShared() const {
+    return m_Storage->refs.GetCount() != 0;
+}
+
+void DataStack::Detach() {
+    if (!IsShared())
+        return;
+
+    // Shared heap payloads are referenced, arena payloads are copied into the new arena.
+    Storage *storage = CreateStorage();
+    const std::vector<Variant> &values = m_Storage->values;
+    storage->values.reserve(values.capacity());
+    storage->values.resize(values.size());
+    for (size_t i = 0; i < values.size(); ++i)
+        storage->values[i].Assign(values[i], storage->arena);
+
+    ReleaseStorage(m_Storage);
+    m_Storage = storage;
+}
+
+size_t DataStack::PushValues(const DataField *fields, size_t count, const void *base) {
+    Detach();
+    if (!fields || !base)
+        return 0;
+
+    const auto *bytes = static_cast<const uint8_t *>(base);
+    size_t offset = m_Storage->values.size();
+    m_Storage->values.resize(offset + count);
+    for (size_t i = 0; i < count; ++i)
+        StoreValue(m_Storage->values[offset + i], fields[i].tag, bytes + fields[i].offset, fields[i].size, m_Storage->arena);
+    return count;
+}
+
+size_t DataStack::GetValues(size_t index, const DataField *fields, size_t count, void *base) const {
+    if (!fields || !base || index >= m_Storage->values.size())
+        return 0;
+
+    auto *bytes = static_cast<uint8_t *>(base);
+    count = std::min(count, m_Storage->values.size() - index);
+    for (size_t i = 0; i < count; ++i)
+        LoadValue(m_Storage->values[index + i], fields[i].tag, bytes + fields[i].offset, fields[i].size);
+    return count;
+}
+
+size_t DataStack::PushArray(uint8_t tag, const void *values, size_t count) {
+    Detach();
+    size_t stride = GetTagSize(tag);
+    if (!values || stride == 0)
+        return 0;
+
+    const auto *bytes = static_cast<const uint8_t *>(values);
+    size_t offset = m_Storage->values.size();
+    m_Storage->values.resize(offset + count);
+    for (size_t i = 0; i < count; ++i)
+        StoreValue(m_Storage->values[offset + i], tag, bytes + i * stride, stride, m_Storage->arena);
+    return count;
+}
+
+size_t DataStack::GetArray(size_t index, uint8_t tag, void *values, size_t count) const {
+    size_t stride = GetTagSize(tag);
+    if (!values || stride == 0 || index >= m_Storage->values.size())
+        return 0;
+
+    auto *bytes = static_cast<uint8_t *>(values);
+    count = std::min(count, m_Storage->values.size() - index);
+    for (size_t i = 0; i < count; ++i)
+        LoadValue(m_Storage->values[index + i], tag, bytes + i * stride, stride);
+    return count;
+}
+
+void DataStack::StoreValue(Variant &cell, uint8_t tag, const void *src, size_t size, Arena *arena) {
+    switch (tag & VAR_TYPE_MASK) {
+        case VAR_TYPE_BOOL:
+            cell = ReadValue<bool>(src);
+            break;
+        case VAR_TYPE_CHAR:
+            cell = ReadValue<char>(src);
+            break;
+        case VAR_TYPE_NUM:
+            switch (tag & VAR_SUBTYPE_MASK) {
+                case VAR_SUBTYPE_UINT8:
+                    cell = ReadValue<uint8_t>(src);
+                    break;
+                case VAR_SUBTYPE_INT8:
+                    cell = ReadValue<int8_t>(src);
+                    break;
+                case VAR_SUBTYPE_UINT16:
+                    cell = ReadValue<uint16_t>(src);
+                    break;
+                case VAR_SUBTYPE_INT16:
+                    cell = ReadValue<int16_t>(src);
+                    break;
+                case VAR_SUBTYPE_UINT32:
+                    cell = ReadValue<uint32_t>(src);
+                    break;
+                case VAR_SUBTYPE_INT32:
+                    cell = ReadValue<int32_t>(src);
+                    break;
+                case VAR_SUBTYPE_UINT64:
+                    cell = ReadValue<uint64_t>(src);
+                    break;
+                case VAR_SUBTYPE_INT64:
+                    cell = ReadValue<int64_t>(src);
+                    break;
+                case VAR_SUBTYPE_FLOAT32:
+                    cell = ReadValue<float>(src);
+                    break;
+                case VAR_SUBTYPE_FLOAT64:
+                    cell = ReadValue<double>(src);
+                    break;
+                default:
+                    break;
+            }
+            break;
+        case VAR_TYPE_STR:
+            cell.SetString(ReadValue<const char *>(src), arena);
+            break;
+        case VAR_TYPE_BUF:
+            cell.SetBuffer(src, size, arena);
+            break;
+        case VAR_TYPE_PTR:
+            cell = ReadValue<void *>(src);
+            break;
+        default:
+            break;
+    }
+}
+
+void DataStack::LoadValue(const Variant &cell, uint8_t tag, void *dst, size_t size) {
+    switch (tag & VAR_TYPE_MASK) {
+        case VAR_TYPE_BOOL:
+            WriteValue(dst, cell.GetBool());
+            break;
+        case VAR_TYPE_CHAR:
+            WriteValue(dst, cell.GetChar());
+            break;
+        case VAR_TYPE_NUM:
+            switch (tag & VAR_SUBTYPE_MASK) {
+                case VAR_SUBTYPE_UINT8:
+                    WriteValue(dst, cell.GetUint8());
+                    break;
+                case VAR_SUBTYPE_INT8:
+                    WriteValue(dst, cell.GetInt8());
+                    break;
+                case VAR_SUBTYPE_UINT16:
+                    WriteValue(dst, cell.GetUint16());
+                    break;
+                case VAR_SUBTYPE_INT16:
+                    WriteValue(dst, cell.GetInt16());
+                    break;
+                case VAR_SUBTYPE_UINT32:
+                    WriteValue(dst, cell.GetUint32());
+                    break;
+                case VAR_SUBTYPE_INT32:
+                    WriteValue(dst, cell.GetInt32());
+                    break;
+                case VAR_SUBTYPE_UINT64:
+                    WriteValue(dst, cell.GetUint64());
+                    break;
+                case VAR_SUBTYPE_INT64:
+                    WriteValue(dst, cell.GetInt64());
+                    break;
+                case VAR_SUBTYPE_FLOAT32:
+                    WriteValue(dst, cell.GetFloat32());
+                    break;
+                case VAR_SUBTYPE_FLOAT64:
+                    WriteValue(dst, cell.GetFloat64());
+                    break;
+                default:
+                    break;
+            }
+            break;
+        case VAR_TYPE_STR:
+            WriteValue(dst, cell.GetString());
+            break;
+        case VAR_TYPE_BUF: {
+            // Copy what fits and zero the rest of the member.
+            const void *buf = cell.GetBuffer();
+            size_t length = buf ? std::min(size, cell.GetSize()) : 0;
+            if (length != 0)
+                memcpy(dst, buf, length);
+            memset(static_cast<uint8_t *>(dst) + length, 0, size - length);
+        }
+            break;
+        case VAR_TYPE_PTR:
+            WriteValue(dst, cell.GetPtr());
+            break;
+        default:
+            break;
+    }
+}
+
+size_t DataStack::Serialize(void *buffer, size_t size) const {
+    size_t required = WriteValues(nullptr, 0);
+    if (buffer && size >= required)
+        WriteValues(static_cast<uint8_t *>(buffer), required);
+    return required;
+}
+
+size_t DataStack::Deserialize(const void *data, size_t size) {
+    if (!data || size < SERIAL_HEADER_SIZE)
+        return 0;
+
+    const auto *bytes = static_cast<const uint8_t *>(data);
+    SerialReader header(bytes, SERIAL_HEADER_SIZE);
+    uint64_t version, reserved, total, count, cursorCount;
+    if (memcmp(header.GetBytes(sizeof(SERIAL_MAGIC)), SERIAL_MAGIC, sizeof(SERIAL_MAGIC)) != 0 ||
+        !header.Get(version, 2) || version != SERIAL_VERSION || !header.Get(reserved, 2) ||
+        !header.Get(total, 4) || total < SERIAL_HEADER_SIZE || total > size ||
+        !header.Get(count, 4) || !header.Get(cursorCount, 4))
+        return 0;
+
+    // Each value takes at least its tag byte, reject counts the block cannot hold before allocating.
+    SerialReader reader(bytes + SERIAL_HEADER_SIZE, static_cast<size_t>(total) - SERIAL_HEADER_SIZE);
+    if (count + cursorCount * 4 > reader.Remaining())
+        return 0;
+
+    std::vector<size_t> cursors;
+    cursors.reserve(cursorCount != 0 ? cursorCount : 1);
+    for (uint64_t i = 0; i < cursorCount; ++i) {
+        uint64_t cursor;
+        if (!reader.Get(cursor, 4) || cursor > count)
+            return 0;
+        cursors.push_back(static_cast<size_t>(cursor));
+    }
+    if (cursors.empty())
+        cursors.push_back(0);
+
+    // Parse into a fresh storage, the current content stays untouched if the data is malformed.
+    Storage *storage = CreateStorage();
+    storage->values.resize(count);
+
+    bool ok = true;
+    for (uint64_t i = 0; ok && i < count; ++i) {
+        Variant &cell = storage->values[i];
+        uint64_t tag, bits, length;
+        if (!reader.Get(tag, 1)) {
+            ok = false;
+            break;
+        }
+
+        switch (tag & VAR_TYPE_MASK) {
+            case VAR_TYPE_NONE:
+                ok = tag == VAR_TYPE_NONE;
+                break;
+            case VAR_TYPE_BOOL:
+                cell = (tag & VAR_SUBTYPE_MASK) == VAR_SUBTYPE_TRUE;
+                break;
+            case VAR_TYPE_CHAR:
+                ok = reader.Get(bits, 1);
+                cell = static_cast<char>(bits);
+                break;
+            case VAR_TYPE_NUM: {
+                const size_t width = GetTagSize(static_cast<uint8_t>(tag));
+                uint8_t value[8];
+                ok = width != 0 && reader.Get(bits, width);
+                if (ok) {
+                    FromBits(bits, width, value);
+                    StoreValue(cell, static_cast<uint8_t>(tag), value, width, storage->arena);
+                }
+                break;
+            }
+            case VAR_TYPE_STR: {
+                // Strings keep their terminator, so readers may also use them in place.
+                const uint8_t *str = reader.Get(length, 4) ? reader.GetBytes(length + 1) : nullptr;
+                ok = str && str[length] == '\0' && memchr(str, '\0', static_cast<size_t>(length)) == nullptr;
+                if (ok)
+                    cell.SetString(reinterpret_cast<const char *>(str), storage->arena);
+                break;
+            }
+            case VAR_TYPE_BUF: {
+                const uint8_t *buf = reader.Get(length, 4) ? reader.GetBytes(length) : nullptr;
+                ok = buf != nullptr;
+                if (ok)
+                    cell.SetBuffer(buf, static_cast<size_t>(length), storage->arena);
+                break;
+            }
+            case VAR_TYPE_PTR:
+                cell = static_cast<void *>(nullptr);
+                break;
+            default:
+                ok = false;
+                break;
+        }
+    }
+
+    if (!ok || reader.Remaining() != 0) {
+        ReleaseStorage(storage);
+        return 0;
+    }
+
+    ReleaseStorage(m_Storage);
+    m_Storage = storage;
+    m_Cursors.swap(cursors);
+    return static_cast<size_t>(total);
+}
+
+size_t DataStack::WriteValues(uint8_t *buffer, size_t total) const {
+    const std::vector<Variant> &values = m_Storage->values;
+
+    SerialWriter writer(buffer);
+    writer.PutBytes(SERIAL_MAGIC, sizeof(SERIAL_MAGIC));
+    writer.Put(SERIAL_VERSION, 2);
+    writer.Put(0, 2);
+    writer.Put(total, 4);
+    writer.Put(values.size(), 4);
+    writer.Put(m_Cursors.size(), 4);
+
+    for (size_t cursor: m_Cursors)
+        writer.Put(cursor, 4);
+
+    for (const Variant &cell: values) {
+        const uint8_t tag = cell.GetTag();
+        writer.Put(tag, 1);
+
+        switch (cell.GetType()) {
+            case VAR_TYPE_CHAR:
+                writer.Put(static_cast<uint8_t>(cell.GetChar()), 1);
+                break;
+            case VAR_TYPE_NUM: {
+                const size_t width = GetTagSize(tag);
+                uint8_t value[8];
+                LoadValue(cell, tag, value, width);
+                writer.Put(ToBits(value, width), width);
+                break;
+            }
+            case VAR_TYPE_STR:
+                writer.Put(cell.GetSize(), 4);
+                writer.PutBytes(cell.GetString(), cell.GetSize());
+                writer.Put(0, 1);
+                break;
+            case VAR_TYPE_BUF:
+                writer.Put(cell.GetSize(), 4);
+                writer.PutBytes(cell.GetBuffer(), cell.GetSize());
+                break;
+            default:
+                // Booleans are fully described by their tag, pointers are written as null.
+                break;
+        }
+    }
+
+    return writer.GetSize();
+}
+
+void DataStack::SetBuffer(size_t index, void *buf, size_t size, DataBufferRelease release, void *userdata) {
+    assert(index < m_Storage->values.size());
+    Detach();
+    m_Storage->values[index].SetBuffer(buf, size, release, userdata);
+}
+
+void *DataStack::AllocBuffer(size_t index, size_t size) {
+    assert(index < m_Storage->values.size());
+    Detach();
+    // Kept off the arena so that copies into other stacks and events share it.
+    return m_Storage->values[index].AllocateBuffer(size);
+}
+
+bool DataStack::GetValue(size_t index, uint8_t tag, void *value, size_t size) const {
+    assert(index < m_Storage->values.size());
+    const Variant &cell = m_Storage->values[index];
+    if (cell.LoadExact(tag, value, size))
+        return true;
+
+    return ConvertValue(cell, tag, value, size);
+}
+
+void DataStack::SetString(size_t index, const char *str) {
+    assert(index < m_Storage->values.size());
+    Detach();
+    m_Storage->values[index].SetString(str, m_Storage->arena);
+}
+
 DataStackFactory &DataStackFactory::GetInstance() {
     static DataStackFactory instance;
     return instance;
@@ -336,4 +1130,88 @@ void *DataStackFactory::CreateInstance(void *data) const {
 void DataStackFactory::DestroyInstance(void *ptr) {
     if (ptr)
         delete static_cast<DataStack *>(ptr);
-}
\ No newline at end of file
+}
+
+DataStackDescFactory &DataStackDescFactory::GetInstance() {
+    static DataStackDescFactory instance;
+    return instance;
+}
+
+void *DataStackDescFactory::CreateInstance(void *data) const {
+    if (data)
+        return new DataStack(*static_cast<const DataStackDesc *>(data));
+    return new DataStack();
+}
+
+void DataStackDescFactory::DestroyInstance(void *ptr) {
+    if (ptr)
+        delete static_cast<DataStack *>(ptr);
+}
+DataStackPool &DataStackPool::GetInstance() {
+    static DataStackPool instance;
+    return instance;
+}
+
+DataStackPool::DataStackPool() : m_Free(DEFAULT_CAPACITY), m_Bytes(0), m_ByteLimit(DEFAULT_BYTE_LIMIT) {}
+
+DataStackPool::~DataStackPool() {
+    Trim();
+}
+
+void *DataStackPool::CreateInstance(void *data) const {
+    const auto *desc = static_cast<const DataStackDesc *>(data);
+
+    DataStack *stack;
+    if (m_Free.Pop(stack)) {
+        m_Bytes.fetch_sub(stack->GetRetainedBytes(), std::memory_order_relaxed);
+        // The last release left the count one below its initial value.
+        stack->AddRef();
+        if (desc)
+            stack->Configure(*desc);
+        else
+            stack->Configure(DataStackDesc{DATA_STACK_DEFAULT, 0, 0});
+    } else {
+        stack = desc ? new DataStack(*desc) : new DataStack();
+        stack->m_Pool = const_cast<DataStackPool *>(this);
+    }
+    return stack;
+}
+
+void DataStackPool::DestroyInstance(void *ptr) {
+    if (ptr)
+        static_cast<DataStack *>(ptr)->Release();
+}
+
+void DataStackPool::SetByteLimit(size_t bytes) {
+    m_ByteLimit.store(bytes, std::memory_order_relaxed);
+    if (m_Bytes.load(std::memory_order_relaxed) > bytes)
+        Trim();
+}
+
+size_t DataStackPool::GetByteLimit() const {
+    return m_ByteLimit.load(std::memory_order_relaxed);
+}
+
+size_t DataStackPool::GetPooledBytes() const {
+    return m_Bytes.load(std::memory_order_relaxed);
+}
+
+void DataStackPool::Trim() {
+    DataStack *stack;
+    while (m_Free.Pop(stack)) {
+        m_Bytes.fetch_sub(stack->GetRetainedBytes(), std::memory_order_relaxed);
+        delete stack;
+    }
+}
+
+void DataStackPool::Recycle(DataStack *stack) {
+    stack->Recycle();
+
+    // Reserve the bytes first so concurrent releases cannot overshoot the limit together.
+    size_t bytes = stack->GetRetainedBytes();
+    size_t pooled = m_Bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    if (pooled > m_ByteLimit.load(std::memory_order_relaxed) || !m_Free.Push(stack)) {
+        m_Bytes.fetch_sub(bytes, std::memory_order_relaxed);
+        delete stack;
+    }
+}
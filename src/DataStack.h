@@ -8,13 +8,18 @@
 #include "Balloon/IDataStack.h"
 #include "Balloon/RefCount.h"
 #include "Balloon/IObjectFactory.h"
+#include "Balloon/IDataStackPool.h"
 #include "WeakRefFlag.h"
 #include "Variant.h"
+#include "MpmcRing.h"
 
 namespace balloon {
+    class DataStackPool;
+
     class DataStack final : public IDataStack {
     public:
         DataStack();
+        explicit DataStack(const DataStackDesc &desc);
 
         DataStack(const DataStack &rhs);
         DataStack(DataStack &&rhs) noexcept = delete;
@@ -28,6 +33,8 @@ namespace balloon {
         int Release() const override;
         IWeakRefFlag *GetWeakRefFlag() const override;
 
+        int GetRefCount() const { return m_RefCount.GetCount(); }
+
         void Clear() override;
         bool Empty() const override;
 
@@ -91,12 +98,69 @@ namespace balloon {
         bool Merge(const IDataStack *other) override;
         IDataStack *Separate() override;
 
+        size_t PushValues(const DataField *fields, size_t count, const void *base) override;
+        size_t GetValues(size_t index, const DataField *fields, size_t count, void *base) const override;
+
+        using IDataStack::PushArray;
+        using IDataStack::GetArray;
+
+        size_t PushArray(uint8_t tag, const void *values, size_t count) override;
+        size_t GetArray(size_t index, uint8_t tag, void *values, size_t count) const override;
+
+        size_t Serialize(void *buffer, size_t size) const override;
+        size_t Deserialize(const void *data, size_t size) override;
+
+        using IDataStack::SetBuffer;
+        using IDataStack::AllocBuffer;
+
+        void SetBuffer(size_t index, void *buf, size_t size, DataBufferRelease release, void *userdata) override;
+        void *AllocBuffer(size_t index, size_t size) override;
+
+        using IDataStack::SetString;
+
+        bool GetValue(size_t index, uint8_t tag, void *value, size_t size) const override;
+        void SetString(size_t index, const char *str) override;
+
     private:
+        friend class DataStackPool;
+
+        static constexpr uint16_t SERIAL_VERSION = 1;
+
+        // Arena bytes reserved per value, only payloads that do not fit in a cell reach the arena.
+        static constexpr size_t ARENA_BYTES_PER_VALUE = 32;
+
+        struct Storage {
+            RefCount refs;
+            std::vector<Variant> values;
+            Arena *arena = nullptr;
+
+            ~Storage();
+        };
+
+        Storage *CreateStorage() const;
+        static void ReleaseStorage(Storage *storage);
+        bool IsShared() const;
+        void Detach();
+
+        void AppendValues(const DataStack &other);
+
+        void Configure(const DataStackDesc &desc);
+        void Recycle();
+        size_t GetRetainedBytes() const;
+
+        static void StoreValue(Variant &cell, uint8_t tag, const void *src, size_t size, Arena *arena);
+        static void LoadValue(const Variant &cell, uint8_t tag, void *dst, size_t size);
+
+        size_t WriteValues(uint8_t *buffer, size_t total) const;
+
         mutable RefCount m_RefCount;
         mutable WeakRefFlag *m_WeakRefFlag = nullptr;
 
-        std::vector<Variant> m_Data;
         std::vector<size_t> m_Cursors;
+        Storage *m_Storage = nullptr;
+        uint32_t m_Flags = DATA_STACK_DEFAULT;
+        size_t m_ArenaSize = 0;
+        DataStackPool *m_Pool = nullptr;
 
         static std::mutex m_RWLock;
     };
@@ -107,6 +171,47 @@ namespace balloon {
         void *CreateInstance(void *data) const override;
         void DestroyInstance(void *ptr) override;
     };
+
+    // Version 2 of the "DataStack" factory, creating the data stack from an optional DataStackDesc.
+    class DataStackDescFactory : public IObjectFactory {
+    public:
+        static DataStackDescFactory &GetInstance();
+        void *CreateInstance(void *data) const override;
+        void DestroyInstance(void *ptr) override;
+    };
+
+    class DataStackPool final : public IDataStackPool {
+    public:
+        static constexpr size_t DEFAULT_CAPACITY = 256;
+        static constexpr size_t DEFAULT_BYTE_LIMIT = 1024 * 1024;
+
+        static DataStackPool &GetInstance();
+
+        DataStackPool();
+
+        DataStackPool(const DataStackPool &rhs) = delete;
+        DataStackPool(DataStackPool &&rhs) noexcept = delete;
+
+        ~DataStackPool();
+
+        DataStackPool &operator=(const DataStackPool &rhs) = delete;
+        DataStackPool &operator=(DataStackPool &&rhs) noexcept = delete;
+
+        void *CreateInstance(void *data) const override;
+        void DestroyInstance(void *ptr) override;
+
+        void SetByteLimit(size_t bytes) override;
+        size_t GetByteLimit() const override;
+        size_t GetPooledBytes() const override;
+        void Trim() override;
+
+        void Recycle(DataStack *stack);
+
+    private:
+        mutable MpmcRing<DataStack *> m_Free;
+        mutable std::atomic<size_t> m_Bytes;
+        std::atomic<size_t> m_ByteLimit;
+    };
 }
 
 #endif // BALLOON_DATASTACK_H
@@ -0,0 +1,102 @@
+#include "DataStackRing.h"
+
+using namespace balloon;
+
+DataStackRing::DataStackRing(const DataStackRingDesc *desc) {
+    size_t capacity = desc && desc->capacity != 0 ? desc->capacity : DEFAULT_CAPACITY;
+    size_t size = 2;
+    while (size < capacity)
+        size <<= 1;
+
+    // Slots are created by the producer on first use, a large ring costs nothing until it fills up.
+    m_Slots = new DataStack *[size]();
+    m_Mask = size - 1;
+    if (desc)
+        m_StackDesc = desc->stack;
+}
+
+DataStackRing::~DataStackRing() {
+    for (size_t i = 0; i <= m_Mask; ++i) {
+        if (m_Slots[i])
+            m_Slots[i]->Release();
+    }
+    delete[] m_Slots;
+}
+
+int DataStackRing::AddRef() const {
+    return m_RefCount.AddRef();
+}
+
+int DataStackRing::Release() const {
+    int r = m_RefCount.Release();
+    if (r == 0) {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        delete const_cast<DataStackRing *>(this);
+    }
+    return r;
+}
+
+size_t DataStackRing::Capacity() const {
+    return m_Mask + 1;
+}
+
+size_t DataStackRing::Size() const {
+    size_t head = m_Head.load(std::memory_order_acquire);
+    size_t tail = m_Tail.load(std::memory_order_acquire);
+    return tail - head;
+}
+
+IDataStack *DataStackRing::BeginWrite() {
+    size_t tail = m_Tail.load(std::memory_order_relaxed);
+    if (tail - m_HeadCache > m_Mask) {
+        m_HeadCache = m_Head.load(std::memory_order_acquire);
+        if (tail - m_HeadCache > m_Mask)
+            return nullptr;
+    }
+
+    // The consumer reads the slot pointer after acquiring the tail published by EndWrite.
+    DataStack *&slot = m_Slots[tail & m_Mask];
+    if (!slot)
+        slot = new DataStack(m_StackDesc);
+    else
+        slot->Clear();
+    return slot;
+}
+
+void DataStackRing::EndWrite() {
+    size_t tail = m_Tail.load(std::memory_order_relaxed);
+    m_Tail.store(tail + 1, std::memory_order_release);
+}
+
+IDataStack *DataStackRing::BeginRead() {
+    size_t head = m_Head.load(std::memory_order_relaxed);
+    if (head == m_TailCache) {
+        m_TailCache = m_Tail.load(std::memory_order_acquire);
+        if (head == m_TailCache)
+            return nullptr;
+    }
+
+    return m_Slots[head & m_Mask];
+}
+
+void DataStackRing::EndRead() {
+    size_t head = m_Head.load(std::memory_order_relaxed);
+    m_Head.store(head + 1, std::memory_order_release);
+}
+
+DataStackRingFactory &DataStackRingFactory::GetInstance() {
+    static DataStackRingFactory instance;
+    return instance;
+}
+
+void *DataStackRingFactory::CreateInstance(void *data) const {
+    const auto *desc = static_cast<const DataStackRingDesc *>(data);
+    if (desc && desc->capacity > DATA_STACK_RING_MAX_CAPACITY)
+        return nullptr;
+    return new DataStackRing(desc);
+}
+
+void DataStackRingFactory::DestroyInstance(void *ptr) {
+    if (ptr)
+        static_cast<DataStackRing *>(ptr)->Release();
+}
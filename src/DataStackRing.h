@@ -0,0 +1,74 @@
+#ifndef BALLOON_DATASTACKRING_H
+#define BALLOON_DATASTACKRING_H
+
+#include <atomic>
+#include <cstddef>
+
+#include "Balloon/IDataStackRing.h"
+#include "Balloon/RefCount.h"
+#include "Balloon/IObjectFactory.h"
+#include "DataStack.h"
+
+namespace balloon {
+    /**
+     * @brief Single-producer single-consumer ring of pre-allocated data stacks.
+     *
+     * Each side owns one index and caches the last value seen of the other one,
+     * so push and pop are a bounded number of steps and only touch the shared
+     * cache line when the cached view says the ring is full or empty.
+     */
+    class DataStackRing final : public IDataStackRing {
+    public:
+        static constexpr size_t DEFAULT_CAPACITY = 16;
+
+        // The capacity of the desc must not exceed DATA_STACK_RING_MAX_CAPACITY.
+        explicit DataStackRing(const DataStackRingDesc *desc = nullptr);
+
+        DataStackRing(const DataStackRing &rhs) = delete;
+        DataStackRing(DataStackRing &&rhs) noexcept = delete;
+
+        ~DataStackRing();
+
+        DataStackRing &operator=(const DataStackRing &rhs) = delete;
+        DataStackRing &operator=(DataStackRing &&rhs) noexcept = delete;
+
+        int AddRef() const override;
+        int Release() const override;
+
+        size_t Capacity() const override;
+        size_t Size() const override;
+
+        IDataStack *BeginWrite() override;
+        void EndWrite() override;
+
+        IDataStack *BeginRead() override;
+        void EndRead() override;
+
+    private:
+        mutable RefCount m_RefCount;
+        DataStack **m_Slots = nullptr;
+        size_t m_Mask = 0;
+        DataStackDesc m_StackDesc = {DATA_STACK_DEFAULT, 0, 0};
+
+        // Producer side.
+        char m_Padding0[64];
+        std::atomic<size_t> m_Tail{0};
+        size_t m_HeadCache = 0;
+
+        // Consumer side.
+        char m_Padding1[64];
+        std::atomic<size_t> m_Head{0};
+        size_t m_TailCache = 0;
+        char m_Padding2[64];
+    };
+
+    class DataStackRingFactory : public IObjectFactory {
+    public:
+        static DataStackRingFactory &GetInstance();
+
+        void *CreateInstance(void *data) const override;
+        void DestroyInstance(void *ptr) override;
+    };
+}
+
+#endif // BALLOON_DATASTACKRING_H
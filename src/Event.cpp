@@ -1,12 +1,72 @@
 #include "Event.h"
 
+#include <mutex>
+#include <vector>
+
+#include "DataStack.h"
+
 using namespace balloon;
 
+namespace {
+    constexpr size_t EVENT_POOL_CAPACITY = 1024;
+
+    // Owned stacks are cleared on every recycle, an arena turns that into a single reset.
+    const DataStackDesc s_DataStackDesc = {DATA_STACK_ARENA, 0, 0};
+
+    struct EventPool {
+        std::mutex lock;
+        std::vector<Event *> events;
+
+        std::atomic<size_t> acquired{0};
+        std::atomic<size_t> reused{0};
+        std::atomic<size_t> stackAcquired{0};
+        std::atomic<size_t> stackReused{0};
+
+        ~EventPool() {
+            for (auto *event: events)
+                delete event;
+        }
+    };
+
+    EventPool s_EventPool;
+}
+
 Event *Event::Create(EventType type) {
+    s_EventPool.acquired.fetch_add(1, std::memory_order_relaxed);
+
+    {
+        std::lock_guard<std::mutex> guard(s_EventPool.lock);
+        if (!s_EventPool.events.empty()) {
+            Event *event = s_EventPool.events.back();
+            s_EventPool.events.pop_back();
+            s_EventPool.reused.fetch_add(1, std::memory_order_relaxed);
+            event->m_Type = type;
+            return event;
+        }
+    }
+
     return new Event(type);
 }
 
-Event::~Event() = default;
+void Event::GetPoolStats(EventPoolStats *stats) {
+    if (!stats)
+        return;
+
+    stats->acquired = s_EventPool.acquired.load(std::memory_order_relaxed);
+    stats->reused = s_EventPool.reused.load(std::memory_order_relaxed);
+    stats->stackAcquired = s_EventPool.stackAcquired.load(std::memory_order_relaxed);
+    stats->stackReused = s_EventPool.stackReused.load(std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> guard(s_EventPool.lock);
+    stats->pooled = s_EventPool.events.size();
+}
+
+Event::~Event() {
+    if (m_OwnedDataStack) {
+        m_OwnedDataStack->Release();
+        m_OwnedDataStack = nullptr;
+    }
+}
 
 int Event::AddRef() const {
     return m_RefCount.AddRef();
@@ -16,7 +76,7 @@ int Event::Release() const {
     int r = m_RefCount.Release();
     if (r == 0) {
         std::atomic_thread_fence(std::memory_order_acquire);
-        delete const_cast<Event *>(this);
+        const_cast<Event *>(this)->Recycle();
     }
     return r;
 }
@@ -45,4 +105,58 @@ void Event::SetDataStack(IDataStack *stack) {
     m_DataStack = stack;
 }
 
-Event::Event(EventType type) : m_Type(type), m_Flag(0) {}
\ No newline at end of file
+IDataStack *Event::AcquireDataStack() {
+    s_EventPool.stackAcquired.fetch_add(1, std::memory_order_relaxed);
+
+    if (m_OwnedDataStack)
+        s_EventPool.stackReused.fetch_add(1, std::memory_order_relaxed);
+    else
+        m_OwnedDataStack = new DataStack(s_DataStackDesc);
+
+    m_DataStack = m_OwnedDataStack;
+    return m_DataStack;
+}
+
+const void *Event::GetPayload(size_t *size) const {
+    if (size)
+        *size = m_Payload.size();
+    return m_Payload.empty() ? nullptr : m_Payload.data();
+}
+
+void Event::SetPayload(const void *data, size_t size) {
+    if (data)
+        m_Payload.assign(static_cast<const uint8_t *>(data), static_cast<const uint8_t *>(data) + size);
+    else
+        m_Payload.clear();
+}
+
+Event::Event(EventType type) : m_Type(type), m_Flag(0) {}
+
+void Event::Recycle() {
+    m_Flag = 0;
+    m_DataStack = nullptr;
+    m_Payload.clear();
+
+    if (m_OwnedDataStack) {
+        // A listener still holding the payload keeps it, the event gets a fresh one next time.
+        if (m_OwnedDataStack->GetRefCount() == 0) {
+            m_OwnedDataStack->Clear();
+        } else {
+            m_OwnedDataStack->Release();
+            m_OwnedDataStack = nullptr;
+        }
+    }
+
+    // Restore the initial reference count for the next owner.
+    m_RefCount.AddRef();
+
+    {
+        std::lock_guard<std::mutex> guard(s_EventPool.lock);
+        if (s_EventPool.events.size() < EVENT_POOL_CAPACITY) {
+            s_EventPool.events.push_back(this);
+            return;
+        }
+    }
+
+    delete this;
+}
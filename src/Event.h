@@ -1,15 +1,21 @@
 #ifndef BALLOON_EVENT_H
 #define BALLOON_EVENT_H
 
+#include <cstdint>
+#include <vector>
+
 #include "Balloon/IEvent.h"
+#include "Balloon/IEventManager.h"
 #include "Balloon/RefCount.h"
 
 namespace balloon {
     class EventManager;
+    class DataStack;
 
     class Event final : public IEvent {
     public:
         static Event *Create(EventType type);
+        static void GetPoolStats(EventPoolStats *stats);
 
         Event(const Event &rhs) = delete;
         Event(Event &&rhs) noexcept = delete;
@@ -32,15 +38,25 @@ namespace balloon {
 
         void SetDataStack(IDataStack *stack) override;
 
+        IDataStack *AcquireDataStack() override;
+
+        const void *GetPayload(size_t *size) const override;
+        void SetPayload(const void *data, size_t size);
+
     private:
         explicit Event(EventType type);
 
+        void Recycle();
+
         mutable RefCount m_RefCount;
 
         EventType m_Type;
         int m_Flag;
 
         IDataStack *m_DataStack = nullptr;
+        DataStack *m_OwnedDataStack = nullptr;
+
+        std::vector<uint8_t> m_Payload;
     };
 }
 
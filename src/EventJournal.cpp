@@ -0,0 +1,344 @@
+#include "EventJournal.h"
+
+#include <cstring>
+#include <string>
+
+#include "Event.h"
+#include "EventManager.h"
+
+using namespace balloon;
+
+namespace {
+    const uint8_t JOURNAL_MAGIC[4] = {'B', 'E', 'V', 'J'};
+
+    // Granularity of the buffer growth when reading a length-prefixed blob.
+    const size_t READ_CHUNK_SIZE = 64 * 1024;
+
+    enum RecordKind : uint8_t {
+        RECORD_TYPE = 1,
+        RECORD_EVENT = 2,
+    };
+
+    enum RecordContent : uint8_t {
+        CONTENT_NESTED = 1 << 0,
+        CONTENT_DATASTACK = 1 << 1,
+        CONTENT_PAYLOAD = 1 << 2,
+    };
+}
+
+EventJournal::EventJournal() = default;
+
+EventJournal::~EventJournal() {
+    Close();
+}
+
+bool EventJournal::Open(const char *path) {
+    if (!path)
+        return false;
+
+    std::lock_guard<std::mutex> guard(m_Mutex);
+
+    if (m_File)
+        return false;
+
+    m_File = fopen(path, "wb");
+    if (!m_File)
+        return false;
+
+    m_Frame = 0;
+    m_Types.clear();
+    m_Buffer.clear();
+    WriteBytes(JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+    WriteFixed(VERSION, 4);
+    fwrite(m_Buffer.data(), 1, m_Buffer.size(), m_File);
+    return true;
+}
+
+void EventJournal::Close() {
+    std::lock_guard<std::mutex> guard(m_Mutex);
+
+    if (m_File) {
+        fclose(m_File);
+        m_File = nullptr;
+    }
+}
+
+bool EventJournal::IsOpen() const {
+    std::lock_guard<std::mutex> guard(m_Mutex);
+    return m_File != nullptr;
+}
+
+void EventJournal::Record(const EventManager &manager, const IEvent *event, uint64_t frame, bool nested) {
+    std::lock_guard<std::mutex> guard(m_Mutex);
+
+    if (!m_File)
+        return;
+
+    m_Buffer.clear();
+
+    EventType type = event->GetType();
+    if (type >= m_Types.size())
+        m_Types.resize(type + 1, false);
+    if (!m_Types[type]) {
+        const char *name = manager.GetEventTypeName(type);
+        if (!name)
+            return;
+
+        size_t len = strlen(name);
+        WriteByte(RECORD_TYPE);
+        WriteVarint(type);
+        WriteVarint(len);
+        WriteBytes(name, len);
+        m_Types[type] = true;
+    }
+
+    IDataStack *stack = event->GetDataStack();
+    size_t payloadSize = 0;
+    const void *payload = event->GetPayload(&payloadSize);
+
+    uint8_t content = 0;
+    if (nested)
+        content |= CONTENT_NESTED;
+    if (stack)
+        content |= CONTENT_DATASTACK;
+    if (payload)
+        content |= CONTENT_PAYLOAD;
+
+    // Frames only move forward, except for events recorded concurrently from other threads.
+    if (frame < m_Frame)
+        frame = m_Frame;
+
+    int flag = event->GetFlag();
+    WriteByte(RECORD_EVENT);
+    WriteVarint(frame - m_Frame);
+    WriteVarint(type);
+    WriteVarint((static_cast<uint64_t>(static_cast<int64_t>(flag)) << 1) ^ static_cast<uint64_t>(static_cast<int64_t>(flag) >> 63));
+    WriteByte(content);
+    if (stack)
+        WriteDataStack(stack);
+    if (payload) {
+        WriteVarint(payloadSize);
+        WriteBytes(payload, payloadSize);
+    }
+    m_Frame = frame;
+
+    fwrite(m_Buffer.data(), 1, m_Buffer.size(), m_File);
+}
+
+void EventJournal::WriteByte(uint8_t value) {
+    m_Buffer.push_back(value);
+}
+
+void EventJournal::WriteVarint(uint64_t value) {
+    while (value >= 0x80) {
+        m_Buffer.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    m_Buffer.push_back(static_cast<uint8_t>(value));
+}
+
+void EventJournal::WriteFixed(uint64_t value, size_t size) {
+    for (size_t i = 0; i < size; ++i)
+        m_Buffer.push_back(static_cast<uint8_t>(value >> (i * 8)));
+}
+
+void EventJournal::WriteBytes(const void *data, size_t size) {
+    auto *bytes = static_cast<const uint8_t *>(data);
+    m_Buffer.insert(m_Buffer.end(), bytes, bytes + size);
+}
+
+void EventJournal::WriteDataStack(const IDataStack *stack) {
+    size_t size = stack->Serialize(nullptr, 0);
+    WriteVarint(size);
+
+    size_t offset = m_Buffer.size();
+    m_Buffer.resize(offset + size);
+    stack->Serialize(m_Buffer.data() + offset, size);
+}
+
+EventReplayer::EventReplayer(EventManager &manager, bool nested) : m_Manager(manager), m_Nested(nested) {}
+
+EventReplayer::~EventReplayer() {
+    Close();
+}
+
+bool EventReplayer::Open(const char *path) {
+    if (!path || m_File)
+        return false;
+
+    m_File = fopen(path, "rb");
+    if (!m_File)
+        return false;
+
+    uint8_t magic[sizeof(JOURNAL_MAGIC)];
+    uint64_t version = 0;
+    if (fread(magic, 1, sizeof(magic), m_File) != sizeof(magic) ||
+        memcmp(magic, JOURNAL_MAGIC, sizeof(magic)) != 0 ||
+        !ReadFixed(version, 4) || version != EventJournal::VERSION) {
+        Close();
+        return false;
+    }
+
+    m_Frame = 0;
+    m_RecordFrame = 0;
+    m_Types.clear();
+    m_Error = false;
+
+    // Start at the first recorded frame rather than replaying the idle frames before it.
+    if (ReadNext())
+        m_Frame = m_RecordFrame;
+    return true;
+}
+
+void EventReplayer::Close() {
+    if (m_Pending) {
+        m_Pending->Release();
+        m_Pending = nullptr;
+    }
+
+    if (m_File) {
+        fclose(m_File);
+        m_File = nullptr;
+    }
+}
+
+bool EventReplayer::IsOpen() const {
+    return m_File != nullptr;
+}
+
+bool EventReplayer::HasError() const {
+    return m_Error;
+}
+
+bool EventReplayer::ReplayFrame() {
+    while (m_Pending && m_RecordFrame <= m_Frame) {
+        if (m_Nested || !m_PendingNested)
+            m_Manager.SendEvent(m_Pending);
+        m_Pending->Release();
+        m_Pending = nullptr;
+        ReadNext();
+    }
+
+    ++m_Frame;
+    return m_Pending != nullptr;
+}
+
+bool EventReplayer::ReadNext() {
+    if (!m_File)
+        return false;
+
+    uint8_t kind;
+    while (true) {
+        if (!ReadByte(kind)) {
+            // End of the journal at a record boundary.
+            m_Error = ferror(m_File) != 0;
+            return false;
+        }
+
+        if (kind == RECORD_TYPE) {
+            uint64_t type, len;
+            if (!ReadVarint(type) || !ReadVarint(len) || !ReadBytes(m_Buffer, len))
+                break;
+
+            std::string name(m_Buffer.begin(), m_Buffer.end());
+            EventType target = m_Manager.GetEventType(name.c_str());
+            if (target == static_cast<EventType>(-1))
+                target = m_Manager.AddEventType(name.c_str());
+
+            if (type >= m_Types.size())
+                m_Types.resize(type + 1, static_cast<EventType>(-1));
+            m_Types[type] = target;
+        } else if (kind == RECORD_EVENT) {
+            uint64_t delta, type, flag;
+            uint8_t content;
+            if (!ReadVarint(delta) || !ReadVarint(type) || !ReadVarint(flag) || !ReadByte(content))
+                break;
+            if (type >= m_Types.size() || m_Types[type] == static_cast<EventType>(-1))
+                break;
+
+            auto *event = static_cast<Event *>(m_Manager.NewEvent(m_Types[type]));
+            if (!event)
+                break;
+            event->SetFlag(static_cast<int>(static_cast<int64_t>(flag >> 1) ^ -static_cast<int64_t>(flag & 1)));
+
+            bool ok = true;
+            if (content & CONTENT_DATASTACK)
+                ok = ReadDataStack(event->AcquireDataStack());
+            if (ok && (content & CONTENT_PAYLOAD)) {
+                uint64_t size;
+                ok = ReadVarint(size) && ReadBytes(m_Buffer, size);
+                if (ok)
+                    event->SetPayload(m_Buffer.data(), m_Buffer.size());
+            }
+            if (!ok) {
+                event->Release();
+                break;
+            }
+
+            m_RecordFrame += delta;
+            m_Pending = event;
+            m_PendingNested = (content & CONTENT_NESTED) != 0;
+            return true;
+        } else {
+            break;
+        }
+    }
+
+    // Truncated or corrupt record.
+    m_Error = true;
+    return false;
+}
+
+bool EventReplayer::ReadByte(uint8_t &value) {
+    int c = fgetc(m_File);
+    if (c == EOF)
+        return false;
+    value = static_cast<uint8_t>(c);
+    return true;
+}
+
+bool EventReplayer::ReadVarint(uint64_t &value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        uint8_t byte;
+        if (!ReadByte(byte))
+            return false;
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0)
+            return true;
+    }
+    return false;
+}
+
+bool EventReplayer::ReadFixed(uint64_t &value, size_t size) {
+    uint8_t bytes[8];
+    if (size > sizeof(bytes) || fread(bytes, 1, size, m_File) != size)
+        return false;
+
+    value = 0;
+    for (size_t i = 0; i < size; ++i)
+        value |= static_cast<uint64_t>(bytes[i]) << (i * 8);
+    return true;
+}
+
+bool EventReplayer::ReadBytes(std::vector<uint8_t> &data, uint64_t size) {
+    // The length comes from the file, so the buffer only grows as far as the file actually goes
+    // instead of trusting a corrupt length with a single allocation.
+    data.clear();
+    while (size > 0) {
+        size_t chunk = size < READ_CHUNK_SIZE ? static_cast<size_t>(size) : READ_CHUNK_SIZE;
+        size_t offset = data.size();
+        data.resize(offset + chunk);
+        if (fread(data.data() + offset, 1, chunk, m_File) != chunk)
+            return false;
+        size -= chunk;
+    }
+    return true;
+}
+
+bool EventReplayer::ReadDataStack(IDataStack *stack) {
+    uint64_t size;
+    if (!ReadVarint(size) || !ReadBytes(m_Buffer, size))
+        return false;
+    return stack->Deserialize(m_Buffer.data(), m_Buffer.size()) == size;
+}
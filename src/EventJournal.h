@@ -0,0 +1,109 @@
+#ifndef BALLOON_EVENTJOURNAL_H
+#define BALLOON_EVENTJOURNAL_H
+
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+#include "Balloon/IEventManager.h"
+
+namespace balloon {
+    class EventManager;
+    class Event;
+
+    /**
+     * @brief Append-only binary log of the events sent through an event manager.
+     *
+     * The file starts with the "BEVJ" magic and a 32-bit version, followed by records:
+     * - Type record: kind 1, type, name length and name. Written before the first event of the type.
+     * - Event record: kind 2, frame delta, type, zigzag flag, content bits, then the serialized
+     *   data stack and the raw payload when present, each prefixed by its length.
+     * Integers are LEB128 varints, data stacks use the IDataStack::Serialize format.
+     */
+    class EventJournal final {
+    public:
+        static constexpr uint32_t VERSION = 2;
+
+        EventJournal();
+
+        EventJournal(const EventJournal &rhs) = delete;
+        EventJournal(EventJournal &&rhs) noexcept = delete;
+
+        ~EventJournal();
+
+        EventJournal &operator=(const EventJournal &rhs) = delete;
+        EventJournal &operator=(EventJournal &&rhs) noexcept = delete;
+
+        bool Open(const char *path);
+        void Close();
+        bool IsOpen() const;
+
+        void Record(const EventManager &manager, const IEvent *event, uint64_t frame, bool nested);
+
+    private:
+        void WriteByte(uint8_t value);
+        void WriteVarint(uint64_t value);
+        void WriteFixed(uint64_t value, size_t size);
+        void WriteBytes(const void *data, size_t size);
+        void WriteDataStack(const IDataStack *stack);
+
+        mutable std::mutex m_Mutex;
+        FILE *m_File = nullptr;
+        uint64_t m_Frame = 0;
+        std::vector<bool> m_Types;
+        std::vector<uint8_t> m_Buffer;
+    };
+
+    /**
+     * @brief Re-injects the events of a journal into an event manager with the original frame timing.
+     *
+     * Events sent by listeners while dispatching another event are skipped by default,
+     * since replaying the outer event makes the listeners send them again.
+     */
+    class EventReplayer final {
+    public:
+
+        explicit EventReplayer(EventManager &manager, bool nested = false);
+
+        EventReplayer(const EventReplayer &rhs) = delete;
+        EventReplayer(EventReplayer &&rhs) noexcept = delete;
+
+        ~EventReplayer();
+
+        EventReplayer &operator=(const EventReplayer &rhs) = delete;
+        EventReplayer &operator=(EventReplayer &&rhs) noexcept = delete;
+
+        bool Open(const char *path);
+        void Close();
+        bool IsOpen() const;
+
+        uint64_t GetFrame() const { return m_Frame; }
+
+        // Replays the events of the current frame and advances it. Returns false once the journal is exhausted,
+        // HasError tells a truncated or corrupt journal from a complete one.
+        bool ReplayFrame();
+        bool HasError() const;
+
+    private:
+        bool ReadNext();
+        bool ReadByte(uint8_t &value);
+        bool ReadVarint(uint64_t &value);
+        bool ReadFixed(uint64_t &value, size_t size);
+        bool ReadBytes(std::vector<uint8_t> &data, uint64_t size);
+        bool ReadDataStack(IDataStack *stack);
+
+        EventManager &m_Manager;
+        bool m_Nested;
+        FILE *m_File = nullptr;
+        uint64_t m_Frame = 0;
+        uint64_t m_RecordFrame = 0;
+        std::vector<EventType> m_Types;
+        std::vector<uint8_t> m_Buffer;
+
+        Event *m_Pending = nullptr;
+        bool m_PendingNested = false;
+        bool m_Error = false;
+    };
+}
+
+#endif // BALLOON_EVENTJOURNAL_H
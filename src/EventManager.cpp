@@ -1,66 +1,195 @@
 #include "EventManager.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include "EventJournal.h"
+#include "EventProfiler.h"
+
 using namespace balloon;
 
+namespace {
+    // Per-thread dispatch state, so nested sends are queued only behind dispatches of the same thread.
+    struct DispatchContext {
+        std::vector<const void *> active;
+        std::vector<std::pair<const void *, IEvent *>> pending;
+    };
+
+    thread_local DispatchContext t_DispatchContext;
+
+    // The async listener record whose OnEventAsync is running on this worker thread, if any.
+    thread_local const void *t_AsyncRecord = nullptr;
+
+    char *CopyName(const char *name) {
+        size_t len = strlen(name);
+        auto *str = new char[len + 1];
+        memcpy(str, name, len + 1);
+        return str;
+    }
+}
+
 EventManager &EventManager::GetInstance() {
     static EventManager instance;
     return instance;
 }
 
-EventManager::~EventManager() = default;
+EventManager::~EventManager() {
+    Reset();
+
+    // No reader outlives the manager, drop what the last epochs still hold.
+    for (auto &retired: m_Retired)
+        retired.deleter(retired.ptr);
+    m_Retired.clear();
+
+    AsyncJob *job;
+    while (m_FreeJobs.Pop(job))
+        delete job;
+}
 
 void EventManager::Reset() {
-    m_EventListeners.clear();
-    m_EventTypeMap.clear();
-    m_EventTypes.clear();
-    m_EventStatus.clear();
+    ClearPostedEvents();
+
+    {
+        std::lock_guard<std::mutex> guard(m_TimerLock);
+        m_FrameTimers.Clear();
+        m_ClockTimers.Clear();
+    }
+
+    // Let the workers run dry before the listeners go away, then drop the completions.
+    m_Workers.Stop();
+    CompleteAsyncJobs(false);
+
+    std::lock_guard<std::mutex> guard(m_WriteLock);
+
+    const size_t count = m_EventTypeCount.load();
+    for (EventType type = 0; type < count; ++type) {
+        EventSlot *slot = GetSlot(type);
+        const AsyncListenerTable *asyncTable = slot->asyncListeners.load();
+        if (asyncTable) {
+            for (auto *record: asyncTable->records)
+                RetireAsyncRecord(record);
+            Retire(asyncTable);
+        }
+        const ListenerTable *table = slot->listeners.load();
+        if (table) {
+            for (auto *record: table->records)
+                Retire(record);
+            Retire(table);
+        }
+        const BatchListenerTable *batchTable = slot->batchListeners.load();
+        if (batchTable)
+            Retire(batchTable);
+        const CoalescePolicy *policy = slot->coalesce.load();
+        if (policy)
+            Retire(policy);
+        RetireName(slot->name.load());
+    }
+    m_EventTypeCount.store(0);
+
+    for (const char *name: m_RenamedNames)
+        RetireName(name);
+    m_RenamedNames.clear();
+
+    for (auto &chunk: m_EventSlots) {
+        EventSlot *slots = chunk.exchange(nullptr);
+        if (slots)
+            Retire(slots, [](void *p) { delete[] static_cast<EventSlot *>(p); });
+    }
+
+    const NameTable *names = m_NameTable.exchange(nullptr);
+    if (names)
+        Retire(names);
+
+    for (auto *pattern: m_Patterns)
+        delete pattern;
+    m_Patterns.clear();
+
+    EventJournal *journal = m_Journal.exchange(nullptr);
+    if (journal) {
+        journal->Close();
+        Retire(journal);
+    }
+
+    Reclaim();
 }
 
 EventType EventManager::AddEventType(const char *name) {
     if (!name) return -1;
-    std::string eventName = name;
-    auto it = m_EventTypeMap.find(eventName);
-    if (it != m_EventTypeMap.end())
+    uint32_t hash = HashEventName(name);
+
+    std::lock_guard<std::mutex> guard(m_WriteLock);
+
+    if (FindEventType(name, hash) != -1)
+        return -1;
+
+    EventType type = m_EventTypeCount.load();
+    if (type >= EVENT_SLOT_CHUNK_SIZE * EVENT_SLOT_CHUNK_COUNT)
         return -1;
 
-    EventType type = m_EventTypes.size();
-    m_EventTypeMap[eventName] = type;
-    m_EventTypes.emplace_back(std::move(eventName));
-    m_EventStatus.push_back(false);
+    auto &chunk = m_EventSlots[type / EVENT_SLOT_CHUNK_SIZE];
+    if (!chunk.load())
+        chunk.store(new EventSlot[EVENT_SLOT_CHUNK_SIZE]);
+
+    EventSlot &slot = chunk.load()[type % EVENT_SLOT_CHUNK_SIZE];
+    slot.name.store(CopyName(name));
+    slot.hash = hash;
+    slot.listeners.store(new ListenerTable);
+    slot.batchListeners.store(new BatchListenerTable);
+    slot.coalesce.store(nullptr);
+    if (!m_Patterns.empty())
+        ApplyPatterns(slot);
+
+    // Publish the slot before the name, readers may resolve the name right away.
+    m_EventTypeCount.store(type + 1, std::memory_order_release);
+
+    const NameTable *names = m_NameTable.load();
+    size_t capacity = names ? names->buckets.size() : 0;
+    if ((type + 1) * 4 > capacity * 3)
+        capacity = capacity == 0 ? 64 : capacity * 2;
+    PublishNameTable(capacity);
+
+    Reclaim();
     return type;
 }
 
 EventType EventManager::GetEventType(const char *name) const {
     if (!name) return -1;
-    auto it = m_EventTypeMap.find(name);
-    if (it == m_EventTypeMap.end())
-        return -1;
-    return it->second;
+    return FindEventType(name, HashEventName(name));
 }
 
 const char *EventManager::GetEventTypeName(EventType type) const {
-    if (type >= m_EventTypes.size())
+    EventSlot *slot = GetSlot(type);
+    if (!slot)
         return nullptr;
-    return m_EventTypes[type].c_str();
+    return slot->name.load(std::memory_order_acquire);
 }
 
 size_t EventManager::GetEventTypeCount() const {
-    return m_EventTypes.size();
+    return m_EventTypeCount.load(std::memory_order_acquire);
 }
 
 bool EventManager::RenameEventType(EventType type, const char *name) {
-    if (type >= m_EventTypes.size() || !name)
+    if (!name)
         return false;
 
-    std::string newName = name;
-    auto it = m_EventTypeMap.find(newName);
-    if (it == m_EventTypeMap.end())
+    EventSlot *slot = GetSlot(type);
+    if (!slot)
         return false;
 
-    auto &oldName = m_EventTypes[type];
-    m_EventTypeMap.erase(oldName);
-    m_EventTypeMap[newName] = type;
-    m_EventTypes[type] = std::move(newName);
+    uint32_t hash = HashEventName(name);
+
+    std::lock_guard<std::mutex> guard(m_WriteLock);
+
+    if (FindEventType(name, hash) != -1)
+        return false;
+
+    m_RenamedNames.push_back(slot->name.exchange(CopyName(name)));
+    slot->hash = hash;
+    PublishNameTable(m_NameTable.load()->buckets.size());
+    ApplyPatterns(*slot);
+
+    Reclaim();
     return true;
 }
 
@@ -68,23 +197,11 @@ bool EventManager::RenameEventType(const char *oldName, const char *newName) {
     if (!oldName || !newName)
         return false;
 
-    std::string name = newName;
-    auto it = m_EventTypeMap.find(name);
-    if (it == m_EventTypeMap.end())
-        return false;
-
-    auto type = GetEventType(oldName);
-    if (type == -1)
-        return false;
-
-    m_EventTypeMap.erase(oldName);
-    m_EventTypeMap[name] = type;
-    m_EventTypes[type] = std::move(name);
-    return true;
+    return RenameEventType(GetEventType(oldName), newName);
 }
 
 IEvent *EventManager::NewEvent(EventType type) {
-    if (type >= m_EventTypes.size())
+    if (!GetSlot(type))
         return nullptr;
     return Event::Create(type);
 }
@@ -97,135 +214,969 @@ bool EventManager::SendEvent(IEvent *event) {
     if (!event)
         return false;
 
-    auto type = event->GetType();
-    if (type >= m_EventTypes.size())
+    EventSlot *slot = GetSlot(event->GetType());
+    if (!slot)
         return false;
 
-    if (m_EventStatus[type])
+    RecordEvent(event);
+    DispatchEvent(*slot, event);
+    return true;
+}
+
+bool EventManager::SendEvent(EventType type) {
+    EventSlot *slot = GetSlot(type);
+    if (!slot)
         return false;
 
-    m_EventStatus[type] = true;
-    auto &listeners = m_EventListeners[type];
-    auto it = listeners.begin();
-    while (it != listeners.end()) {
-        if ((*it)->OnEvent(event) == 0) {
-            it = listeners.erase(it);
+    auto *event = Event::Create(type);
+    RecordEvent(event);
+    DispatchEvent(*slot, event);
+    event->Release();
+    return true;
+}
+
+bool EventManager::SendEvent(const char *name) {
+    return SendEvent(GetEventType(name));
+}
+
+bool EventManager::AddListener(EventType eventType, IEventListener *listener) {
+    return AddFilteredListener(eventType, listener, 0, EVENT_PHASE_NORMAL, 0, 0);
+}
+
+bool EventManager::AddListener(const char *eventName, IEventListener *listener) {
+    return AddFilteredListener(eventName, listener, 0, EVENT_PHASE_NORMAL, 0, 0);
+}
+
+bool EventManager::RemoveListener(EventType eventType, IEventListener *listener) {
+    if (!listener)
+        return false;
+
+    EventSlot *slot = GetSlot(eventType);
+    if (!slot)
+        return false;
+
+    std::lock_guard<std::mutex> guard(m_WriteLock);
+
+    const ListenerTable *current = slot->listeners.load();
+    auto *table = new ListenerTable;
+    table->records.reserve(current->records.size());
+    for (auto *record: current->records) {
+        if (record->listener == listener) {
+            record->removed.store(true, std::memory_order_relaxed);
+            Retire(record);
         } else {
-            ++it;
+            table->records.push_back(record);
         }
     }
-    m_EventStatus[type] = false;
+    PublishListeners(*slot, table);
 
+    Reclaim();
     return true;
 }
 
-bool EventManager::SendEvent(EventType type) {
-    if (type >= m_EventTypes.size())
+bool EventManager::RemoveListener(const char *eventName, IEventListener *listener) {
+    if (!eventName || !listener)
         return false;
 
-    if (m_EventStatus[type])
+    if (IsPattern(eventName))
+        return RemovePatternListener(eventName, listener);
+
+    return RemoveListener(GetEventType(eventName), listener);
+}
+
+bool EventManager::AddAsyncListener(EventType eventType, IAsyncEventListener *listener) {
+    if (!listener)
         return false;
 
-    m_EventStatus[type] = true;
-    auto *event = Event::Create(type);
-    auto &listeners = m_EventListeners[type];
-    auto it = listeners.begin();
-    while (it != listeners.end()) {
-        if ((*it)->OnEvent(event) == 0) {
-            it = listeners.erase(it);
-        } else {
-            ++it;
+    EventSlot *slot = GetSlot(eventType);
+    if (!slot)
+        return false;
+
+    std::lock_guard<std::mutex> guard(m_WriteLock);
+
+    if (!m_Workers.IsRunning())
+        m_Workers.Start();
+
+    const AsyncListenerTable *current = slot->asyncListeners.load();
+    auto *table = current ? new AsyncListenerTable(*current) : new AsyncListenerTable;
+    table->records.push_back(new AsyncListenerRecord(listener));
+    if (current)
+        Retire(current);
+    slot->asyncListeners.store(table);
+
+    Reclaim();
+    return true;
+}
+
+bool EventManager::RemoveAsyncListener(EventType eventType, IAsyncEventListener *listener) {
+    if (!listener)
+        return false;
+
+    EventSlot *slot = GetSlot(eventType);
+    if (!slot)
+        return false;
+
+    std::vector<AsyncListenerRecord *> removed;
+    {
+        std::lock_guard<std::mutex> guard(m_WriteLock);
+
+        const AsyncListenerTable *current = slot->asyncListeners.load();
+        if (!current)
+            return true;
+
+        std::vector<AsyncListenerRecord *> records;
+        for (auto *record: current->records) {
+            if (record->listener == listener) {
+                // Keep the record alive through the wait below, Reclaim on another thread may free it otherwise.
+                record->refs.fetch_add(1, std::memory_order_relaxed);
+                removed.push_back(record);
+                RetireAsyncRecord(record);
+            } else {
+                records.push_back(record);
+            }
         }
+        Retire(current);
+        // An empty table is unpublished so that dispatch skips the async path with a single load.
+        slot->asyncListeners.store(records.empty() ? nullptr : new AsyncListenerTable{records});
+
+        Reclaim();
     }
-    event->Release();
-    m_EventStatus[type] = false;
 
+    // The caller may destroy the listener once this returns, wait for the calls already running.
+    // A listener removing itself from OnEventAsync does not wait for its own call.
+    for (auto *record: removed) {
+        const int self = t_AsyncRecord == record ? 1 : 0;
+        while (record->running.load() > self)
+            std::this_thread::yield();
+        ReleaseAsyncRecord(record);
+    }
     return true;
 }
 
-bool EventManager::SendEvent(const char *name) {
-    return SendEvent(GetEventType(name));
+bool EventManager::RemoveAllListeners(EventType eventType) {
+    EventSlot *slot = GetSlot(eventType);
+    if (!slot)
+        return false;
+
+    std::lock_guard<std::mutex> guard(m_WriteLock);
+
+    for (auto *record: slot->listeners.load()->records) {
+        record->removed.store(true, std::memory_order_relaxed);
+        Retire(record);
+    }
+    PublishListeners(*slot, new ListenerTable);
+
+    Reclaim();
+    return true;
 }
 
-bool EventManager::AddListener(EventType eventType, IEventListener *listener) {
-    if (eventType >= m_EventTypes.size() || !listener)
+bool EventManager::RemoveAllListeners(const char *eventName) {
+    if (!eventName)
+        return false;
+
+    return RemoveAllListeners(GetEventType(eventName));
+}
+
+bool EventManager::PostEvent(IEvent *event) {
+    if (!event)
         return false;
 
-    if (m_EventStatus[eventType])
+    event->AddRef();
+    m_PostedEvents.Push(event);
+    m_PostedEventCount.fetch_add(1, std::memory_order_release);
+    return true;
+}
+
+bool EventManager::PostEvent(EventType type) {
+    if (!GetSlot(type))
         return false;
 
-    m_EventListeners[eventType].push_back(listener);
+    m_PostedEvents.Push(Event::Create(type));
+    m_PostedEventCount.fetch_add(1, std::memory_order_release);
     return true;
 }
 
-bool EventManager::AddListener(const char *eventName, IEventListener *listener) {
-    if (!eventName || !listener)
+bool EventManager::PostEvent(const char *name) {
+    return PostEvent(GetEventType(name));
+}
+
+bool EventManager::SetEventCoalescing(EventType type, EventCoalesceMode mode, int keyIndex,
+                                      EventMergeCallback merge, void *userdata) {
+    if (mode < EVENT_COALESCE_NONE || mode > EVENT_COALESCE_MERGE)
         return false;
 
-    auto type = GetEventType(eventName);
-    if (type == -1)
+    if (mode == EVENT_COALESCE_MERGE && !merge)
         return false;
 
-    if (m_EventStatus[type])
+    EventSlot *slot = GetSlot(type);
+    if (!slot)
         return false;
 
-    m_EventListeners[type].push_back(listener);
+    std::lock_guard<std::mutex> guard(m_WriteLock);
+
+    const CoalescePolicy *policy = nullptr;
+    if (mode != EVENT_COALESCE_NONE)
+        policy = new CoalescePolicy{mode, keyIndex, merge, userdata};
+
+    const CoalescePolicy *old = slot->coalesce.exchange(policy);
+    if (old)
+        Retire(old);
+
+    Reclaim();
     return true;
 }
 
-bool EventManager::RemoveListener(EventType eventType, IEventListener *listener) {
-    if (eventType >= m_EventTypes.size() || !listener)
+bool EventManager::AddBatchListener(EventType eventType, IEventBatchListener *listener) {
+    if (!listener)
         return false;
 
-    if (m_EventStatus[eventType])
+    EventSlot *slot = GetSlot(eventType);
+    if (!slot)
         return false;
 
-    auto &listeners = m_EventListeners[eventType];
-    listeners.erase(std::remove(listeners.begin(), listeners.end(), listener), listeners.end());
+    std::lock_guard<std::mutex> guard(m_WriteLock);
+
+    auto *table = new BatchListenerTable(*slot->batchListeners.load());
+    table->listeners.push_back(listener);
+    Retire(slot->batchListeners.exchange(table));
+
+    Reclaim();
     return true;
 }
 
-bool EventManager::RemoveListener(const char *eventName, IEventListener *listener) {
-    if (!eventName || !listener)
+bool EventManager::RemoveBatchListener(EventType eventType, IEventBatchListener *listener) {
+    if (!listener)
         return false;
 
-    auto type = GetEventType(eventName);
-    if (type == -1)
+    EventSlot *slot = GetSlot(eventType);
+    if (!slot)
         return false;
 
-    if (m_EventStatus[type])
-        return false;
+    std::lock_guard<std::mutex> guard(m_WriteLock);
 
-    auto &listeners = m_EventListeners[type];
-    listeners.erase(std::remove(listeners.begin(), listeners.end(), listener), listeners.end());
+    RemoveBatchListener(*slot, listener);
+
+    Reclaim();
     return true;
 }
 
-bool EventManager::RemoveAllListeners(EventType eventType) {
-    if (eventType >= m_EventTypes.size())
+void EventManager::DispatchEvents() {
+    m_Frame.fetch_add(1, std::memory_order_relaxed);
+
+    CompleteAsyncJobs(true);
+
+    // Events posted while draining are left for the next frame.
+    size_t count = m_PostedEventCount.load(std::memory_order_acquire);
+
+    auto &events = m_FrameEvents;
+    IEvent *event = nullptr;
+    while (events.size() < count && m_PostedEvents.Pop(event))
+        events.push_back(event);
+
+    if (!events.empty()) {
+        m_PostedEventCount.fetch_sub(events.size(), std::memory_order_relaxed);
+
+        CoalesceEvents(events);
+
+        for (auto *e: events) {
+            if (e)
+                SendEvent(e);
+        }
+
+        DeliverBatches(events);
+
+        for (auto *e: events) {
+            if (e)
+                e->Release();
+        }
+        events.clear();
+    }
+
+    // Frame boundary, free the tables retired while readers were active.
+    std::lock_guard<std::mutex> guard(m_WriteLock);
+    Reclaim();
+}
+
+EventTimer EventManager::ScheduleEvent(EventType type, uint32_t delay, EventTimerUnit unit, bool repeat) {
+    if (!GetSlot(type))
+        return 0;
+
+    auto *event = Event::Create(type);
+    EventTimer timer = ScheduleEvent(event, delay, unit, repeat);
+    event->Release();
+    return timer;
+}
+
+EventTimer EventManager::ScheduleEvent(IEvent *event, uint32_t delay, EventTimerUnit unit, bool repeat) {
+    if (!event || !GetSlot(event->GetType()))
+        return 0;
+
+    if (unit != EVENT_TIMER_FRAMES && unit != EVENT_TIMER_MILLISECONDS)
+        return 0;
+
+    // A delay of 0 is treated as 1, for the period of repeating timers as well.
+    delay = std::max(delay, 1u);
+
+    std::lock_guard<std::mutex> guard(m_TimerLock);
+
+    EventTimer timer = ++m_NextTimer;
+    event->AddRef();
+    if (unit == EVENT_TIMER_FRAMES) {
+        m_FrameTimers.Add(timer, event, delay, repeat ? delay : 0);
+    } else {
+        // The clock wheel lags behind by the time since the last update, count the delay from now.
+        // The current millisecond is already partly elapsed, one more tick keeps the timer from firing early.
+        uint64_t behind = GetClockTicks() - m_ClockTicks;
+        m_ClockTimers.Add(timer, event, static_cast<uint32_t>(std::min<uint64_t>(delay + behind + 1, UINT32_MAX)), repeat ? delay : 0);
+    }
+    return timer;
+}
+
+bool EventManager::CancelScheduledEvent(EventTimer timer) {
+    if (timer == 0)
         return false;
 
-    if (m_EventStatus[eventType])
+    std::lock_guard<std::mutex> guard(m_TimerLock);
+    return m_FrameTimers.Cancel(timer) || m_ClockTimers.Cancel(timer);
+}
+
+void EventManager::UpdateTimers() {
+    {
+        std::lock_guard<std::mutex> guard(m_TimerLock);
+
+        m_FrameTimers.Advance(1, m_DueEvents);
+
+        uint64_t ticks = GetClockTicks();
+        m_ClockTimers.Advance(ticks - m_ClockTicks, m_DueEvents);
+        m_ClockTicks = ticks;
+    }
+
+    // Send outside the lock, listeners may schedule or cancel timers.
+    for (size_t i = 0; i < m_DueEvents.size(); ++i) {
+        SendEvent(m_DueEvents[i]);
+        m_DueEvents[i]->Release();
+    }
+    m_DueEvents.clear();
+}
+
+uint64_t EventManager::GetClockTicks() {
+    auto now = std::chrono::steady_clock::now();
+    if (!m_ClockStarted) {
+        m_ClockStart = now;
+        m_ClockStarted = true;
+    }
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(now - m_ClockStart).count());
+}
+
+void EventManager::SetJournal(EventJournal *journal) {
+    std::lock_guard<std::mutex> guard(m_WriteLock);
+
+    // Senders still recording into the previous journal hold a read guard, it is closed
+    // right away and freed once they are gone.
+    EventJournal *old = m_Journal.exchange(journal);
+    if (old) {
+        old->Close();
+        Retire(old);
+    }
+    Reclaim();
+}
+
+bool EventManager::HasJournal() const {
+    return m_Journal.load(std::memory_order_acquire) != nullptr;
+}
+
+void EventManager::GetEventPoolStats(EventPoolStats *stats) const {
+    Event::GetPoolStats(stats);
+}
+
+EventType EventManager::GetEventTypeByHash(const char *name, uint32_t hash) const {
+    if (!name) return -1;
+    return FindEventType(name, hash);
+}
+
+bool EventManager::AddListenerEx(EventType eventType, IEventListener *listener, int priority, EventPhase phase) {
+    return AddFilteredListener(eventType, listener, priority, phase, 0, 0);
+}
+
+bool EventManager::AddListenerEx(const char *eventName, IEventListener *listener, int priority, EventPhase phase) {
+    return AddFilteredListener(eventName, listener, priority, phase, 0, 0);
+}
+
+bool EventManager::AddFilteredListener(EventType eventType, IEventListener *listener, int priority, EventPhase phase,
+                                       int flagMask, int flagValue) {
+    if (!listener)
+        return false;
+
+    if (phase < EVENT_PHASE_PRE || phase > EVENT_PHASE_POST)
+        return false;
+
+    EventSlot *slot = GetSlot(eventType);
+    if (!slot)
         return false;
 
-    m_EventListeners[eventType].clear();
+    std::lock_guard<std::mutex> guard(m_WriteLock);
+
+    auto *table = new ListenerTable(*slot->listeners.load());
+    InsertRecord(table, new ListenerRecord(listener, priority, phase, flagMask, flagValue));
+    PublishListeners(*slot, table);
+
+    Reclaim();
     return true;
 }
 
-bool EventManager::RemoveAllListeners(const char *eventName) {
-    if (!eventName)
+bool EventManager::AddFilteredListener(const char *eventName, IEventListener *listener, int priority, EventPhase phase,
+                                       int flagMask, int flagValue) {
+    if (!eventName || !listener)
         return false;
 
-    auto type = GetEventType(eventName);
-    if (type == -1)
+    if (IsPattern(eventName))
+        return AddPatternListener(eventName, listener, priority, phase, flagMask, flagValue);
+
+    return AddFilteredListener(GetEventType(eventName), listener, priority, phase, flagMask, flagValue);
+}
+
+EventManager::EventManager() = default;
+
+EventManager::EventSlot *EventManager::GetSlot(EventType type) const {
+    if (type >= m_EventTypeCount.load(std::memory_order_acquire))
+        return nullptr;
+    return &m_EventSlots[type / EVENT_SLOT_CHUNK_SIZE].load(std::memory_order_acquire)[type % EVENT_SLOT_CHUNK_SIZE];
+}
+
+EventType EventManager::FindEventType(const char *name, uint32_t hash) const {
+    ReadGuard guard(*this);
+
+    const NameTable *names = m_NameTable.load();
+    if (!names)
+        return -1;
+
+    const auto &buckets = names->buckets;
+    const size_t mask = buckets.size() - 1;
+    for (size_t i = hash & mask; buckets[i].type != 0; i = (i + 1) & mask) {
+        if (buckets[i].hash != hash)
+            continue;
+
+        EventType type = buckets[i].type - 1;
+        const char *str = GetSlot(type)->name.load(std::memory_order_acquire);
+        if (strcmp(str, name) == 0)
+            return type;
+    }
+    return -1;
+}
+
+void EventManager::RecordEvent(const IEvent *event) const {
+    if (!m_Journal.load(std::memory_order_relaxed))
+        return;
+
+    ReadGuard guard(*this);
+    EventJournal *journal = m_Journal.load(std::memory_order_acquire);
+    if (journal)
+        journal->Record(*this, event, m_Frame.load(std::memory_order_relaxed), !t_DispatchContext.active.empty());
+}
+
+void EventManager::DispatchEvent(EventSlot &slot, IEvent *event) {
+    auto &context = t_DispatchContext;
+    if (std::find(context.active.begin(), context.active.end(), &slot) != context.active.end()) {
+        // A nested send of the same type is delivered after the outer dispatch completes.
+        event->AddRef();
+        context.pending.emplace_back(&slot, event);
+        return;
+    }
+
+    context.active.push_back(&slot);
+
+    InvokeListeners(slot, event);
+    SubmitAsyncJobs(slot, event);
+
+    // Nested sends may queue further events while the queue is being drained.
+    auto &pending = context.pending;
+    auto it = std::find_if(pending.begin(), pending.end(), [&slot](const std::pair<const void *, IEvent *> &p) {
+        return p.first == &slot;
+    });
+    while (it != pending.end()) {
+        IEvent *next = it->second;
+        pending.erase(it);
+        InvokeListeners(slot, next);
+        SubmitAsyncJobs(slot, next);
+        next->Release();
+        it = std::find_if(pending.begin(), pending.end(), [&slot](const std::pair<const void *, IEvent *> &p) {
+            return p.first == &slot;
+        });
+    }
+
+    context.active.pop_back();
+}
+
+void EventManager::InvokeListeners(EventSlot &slot, IEvent *event) {
+    ReadGuard guard(*this);
+
+    if (EventProfiler::IsActive()) {
+        InvokeListenersProfiled(slot, event);
+        return;
+    }
+
+    // Changes made by listeners publish a new table, this walk keeps the one it started with.
+    const ListenerTable *table = slot.listeners.load();
+    const int flag = event->GetFlag();
+    const int *masks = table->flagMasks.data();
+    const int *values = table->flagValues.data();
+    const size_t count = table->records.size();
+    for (size_t i = 0; i < count; ++i) {
+        if ((flag & masks[i]) != values[i])
+            continue;
+
+        ListenerRecord *record = table->records[i];
+        if (record->removed.load(std::memory_order_relaxed))
+            continue;
+
+        if (record->listener->OnEvent(event) == 0)
+            RemoveListenerRecord(slot, record);
+    }
+}
+
+void EventManager::InvokeListenersProfiled(EventSlot &slot, IEvent *event) {
+    auto &profiler = EventProfiler::GetInstance();
+    const EventType type = event->GetType();
+    const uint64_t start = EventProfiler::Now();
+
+    const ListenerTable *table = slot.listeners.load();
+    const int flag = event->GetFlag();
+    const size_t count = table->records.size();
+    for (size_t i = 0; i < count; ++i) {
+        if ((flag & table->flagMasks[i]) != table->flagValues[i])
+            continue;
+
+        ListenerRecord *record = table->records[i];
+        if (record->removed.load(std::memory_order_relaxed))
+            continue;
+
+        const uint64_t begin = EventProfiler::Now();
+        int ret = record->listener->OnEvent(event);
+        profiler.RecordListener(type, record->listener, EventProfiler::Now() - begin);
+
+        if (ret == 0)
+            RemoveListenerRecord(slot, record);
+    }
+
+    profiler.RecordEvent(type, EventProfiler::Now() - start);
+}
+
+void EventManager::RemoveListenerRecord(EventSlot &slot, ListenerRecord *record) {
+    std::lock_guard<std::mutex> guard(m_WriteLock);
+
+    if (record->removed.load(std::memory_order_relaxed))
+        return;
+
+    const ListenerTable *current = slot.listeners.load();
+    auto *table = new ListenerTable;
+    table->records.reserve(current->records.size() - 1);
+    for (auto *r: current->records) {
+        if (r != record)
+            table->records.push_back(r);
+    }
+
+    record->removed.store(true, std::memory_order_relaxed);
+    Retire(record);
+    PublishListeners(slot, table);
+}
+
+void EventManager::CoalesceEvents(std::vector<IEvent *> &events) {
+    ReadGuard guard(*this);
+
+    // Open addressing on (type, key), the table is sized for the whole frame and reused between frames.
+    size_t capacity = 16;
+    while (capacity < events.size() * 2)
+        capacity *= 2;
+    m_CoalesceTable.assign(capacity, {0, 0, 0});
+
+    const size_t mask = capacity - 1;
+    for (size_t i = 0; i < events.size(); ++i) {
+        IEvent *event = events[i];
+        EventType type = event->GetType();
+        EventSlot *slot = GetSlot(type);
+        if (!slot)
+            continue;
+
+        const CoalescePolicy *policy = slot->coalesce.load();
+        if (!policy)
+            continue;
+
+        uint64_t key = GetCoalesceKey(event, policy->keyIndex);
+        size_t b = static_cast<size_t>(((key ^ type) * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+        while (m_CoalesceTable[b].index != 0 &&
+               (m_CoalesceTable[b].type != type || m_CoalesceTable[b].key != key))
+            b = (b + 1) & mask;
+
+        CoalesceBucket &bucket = m_CoalesceTable[b];
+        if (bucket.index == 0) {
+            bucket = {i + 1, type, key};
+            continue;
+        }
+
+        IEvent *&first = events[bucket.index - 1];
+        if (policy->mode == EVENT_COALESCE_LAST) {
+            first->Release();
+            first = nullptr;
+            bucket.index = i + 1;
+        } else {
+            policy->merge(first, event, policy->userdata);
+            event->Release();
+            events[i] = nullptr;
+        }
+    }
+}
+
+void EventManager::DeliverBatches(const std::vector<IEvent *> &events) {
+    ReadGuard guard(*this);
+
+    // Group the events by type while keeping their posting order within each type.
+    auto &order = m_BatchOrder;
+    for (size_t i = 0; i < events.size(); ++i) {
+        if (!events[i])
+            continue;
+
+        EventSlot *slot = GetSlot(events[i]->GetType());
+        if (slot && !slot->batchListeners.load()->listeners.empty())
+            order.emplace_back(events[i]->GetType(), i);
+    }
+    std::sort(order.begin(), order.end());
+
+    auto &batch = m_BatchEvents;
+    for (auto &entry: order)
+        batch.push_back(events[entry.second]);
+
+    for (size_t begin = 0, end; begin < order.size(); begin = end) {
+        EventType type = order[begin].first;
+        for (end = begin + 1; end < order.size() && order[end].first == type; ++end)
+            continue;
+
+        EventSlot *slot = GetSlot(type);
+        if (!slot)
+            continue;
+
+        const BatchListenerTable *table = slot->batchListeners.load();
+        for (auto *listener: table->listeners) {
+            if (listener->OnEvents(&batch[begin], end - begin) == 0) {
+                std::lock_guard<std::mutex> lock(m_WriteLock);
+                RemoveBatchListener(*slot, listener);
+            }
+        }
+    }
+
+    order.clear();
+    batch.clear();
+}
+
+void EventManager::RemoveBatchListener(EventSlot &slot, IEventBatchListener *listener) {
+    const BatchListenerTable *current = slot.batchListeners.load();
+    auto *table = new BatchListenerTable;
+    table->listeners.reserve(current->listeners.size());
+    for (auto *l: current->listeners) {
+        if (l != listener)
+            table->listeners.push_back(l);
+    }
+    Retire(slot.batchListeners.exchange(table));
+}
+
+uint64_t EventManager::GetCoalesceKey(const IEvent *event, int keyIndex) {
+    if (keyIndex < 0)
+        return 0;
+
+    IDataStack *stack = event->GetDataStack();
+    if (!stack || static_cast<size_t>(keyIndex) >= stack->Size())
+        return 0;
+
+    auto index = static_cast<size_t>(keyIndex);
+    switch (stack->GetType(index)) {
+        case DATA_TYPE_BOOL:
+            return stack->GetBool(index) ? 1 : 0;
+        case DATA_TYPE_CHAR:
+            return static_cast<unsigned char>(stack->GetChar(index));
+        case DATA_TYPE_NUM:
+            switch (stack->GetSubtype(index)) {
+                case DATA_SUBTYPE_UINT64:
+                    return stack->GetUint64(index);
+                case DATA_SUBTYPE_FLOAT32:
+                case DATA_SUBTYPE_FLOAT64: {
+                    double value = stack->GetFloat64(index);
+                    uint64_t bits;
+                    memcpy(&bits, &value, sizeof(bits));
+                    return bits;
+                }
+                default:
+                    return static_cast<uint64_t>(stack->GetInt64(index));
+            }
+        case DATA_TYPE_STR: {
+            const char *str = stack->GetString(index);
+            return str ? HashEventName(str) : 0;
+        }
+        case DATA_TYPE_BUF: {
+            auto *data = static_cast<const uint8_t *>(stack->GetBuffer(index, nullptr));
+            size_t size = stack->GetSize(index);
+            uint64_t hash = 14695981039346656037ull;
+            for (size_t i = 0; data && i < size; ++i)
+                hash = (hash ^ data[i]) * 1099511628211ull;
+            return hash;
+        }
+        case DATA_TYPE_PTR:
+            return reinterpret_cast<uintptr_t>(stack->GetPtr(index));
+        default:
+            return 0;
+    }
+}
+
+void EventManager::SubmitAsyncJobs(EventSlot &slot, IEvent *event) {
+    if (!slot.asyncListeners.load(std::memory_order_acquire))
+        return;
+
+    ReadGuard guard(*this);
+
+    const AsyncListenerTable *table = slot.asyncListeners.load();
+    if (!table)
+        return;
+
+    for (auto *record: table->records) {
+        if (record->removed.load(std::memory_order_relaxed))
+            continue;
+
+        record->refs.fetch_add(1, std::memory_order_relaxed);
+        event->AddRef();
+        AsyncJob *job = AcquireAsyncJob();
+        job->record = record;
+        job->event = event;
+        job->result = 0;
+        if (!m_Workers.Submit(&EventManager::RunAsyncJob, job)) {
+            event->Release();
+            ReleaseAsyncRecord(record);
+            RecycleAsyncJob(job);
+        }
+    }
+}
+
+EventManager::AsyncJob *EventManager::AcquireAsyncJob() {
+    AsyncJob *job;
+    if (!m_FreeJobs.Pop(job))
+        job = new AsyncJob{this, nullptr, nullptr, 0};
+    return job;
+}
+
+void EventManager::RecycleAsyncJob(AsyncJob *job) {
+    if (!m_FreeJobs.Push(job))
+        delete job;
+}
+
+void EventManager::RunAsyncJob(void *data) {
+    auto *job = static_cast<AsyncJob *>(data);
+    AsyncListenerRecord *record = job->record;
+
+    // Raise the running count before checking for removal, RemoveAsyncListener checks them the other way around.
+    record->running.fetch_add(1);
+    if (!record->removed.load()) {
+        t_AsyncRecord = record;
+        job->result = record->listener->OnEventAsync(job->event);
+        t_AsyncRecord = nullptr;
+    }
+    record->running.fetch_sub(1);
+
+    job->manager->m_CompletedJobs.Push(job);
+}
+
+void EventManager::CompleteAsyncJobs(bool notify) {
+    AsyncJob *job = nullptr;
+    while (m_CompletedJobs.Pop(job)) {
+        if (notify && !job->record->removed.load())
+            job->record->listener->OnEventCompleted(job->event, job->result);
+        job->event->Release();
+        ReleaseAsyncRecord(job->record);
+        RecycleAsyncJob(job);
+    }
+}
+
+void EventManager::RetireAsyncRecord(AsyncListenerRecord *record) {
+    record->removed.store(true);
+    // Readers may still be taking references from the old table, drop the table's reference once they are gone.
+    Retire(record, [](void *p) { ReleaseAsyncRecord(static_cast<AsyncListenerRecord *>(p)); });
+}
+
+void EventManager::ReleaseAsyncRecord(AsyncListenerRecord *record) {
+    if (record->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        delete record;
+}
+
+bool EventManager::IsPattern(const char *name) {
+    size_t len = strlen(name);
+    return len != 0 && name[len - 1] == '*' && (len == 1 || name[len - 2] == '/');
+}
+
+bool EventManager::MatchPattern(const PatternSubscription &pattern, const char *name) {
+    return strncmp(name, pattern.prefix.c_str(), pattern.prefix.size()) == 0;
+}
+
+bool EventManager::AddPatternListener(const char *pattern, IEventListener *listener, int priority, EventPhase phase,
+                                      int flagMask, int flagValue) {
+    if (phase < EVENT_PHASE_PRE || phase > EVENT_PHASE_POST)
         return false;
 
-    if (m_EventStatus[type])
+    std::lock_guard<std::mutex> guard(m_WriteLock);
+
+    auto *subscription = new PatternSubscription{std::string(pattern, strlen(pattern) - 1), listener, priority, phase,
+                                                 flagMask, flagValue};
+    m_Patterns.push_back(subscription);
+
+    // Expand the pattern into the tables of the matching types, dispatch never sees the pattern itself.
+    const size_t count = m_EventTypeCount.load();
+    for (EventType type = 0; type < count; ++type) {
+        EventSlot *slot = GetSlot(type);
+        if (!MatchPattern(*subscription, slot->name.load()))
+            continue;
+
+        auto *table = new ListenerTable(*slot->listeners.load());
+        InsertRecord(table, new ListenerRecord(listener, priority, phase, flagMask, flagValue, subscription));
+        PublishListeners(*slot, table);
+    }
+
+    Reclaim();
+    return true;
+}
+
+bool EventManager::RemovePatternListener(const char *pattern, IEventListener *listener) {
+    std::lock_guard<std::mutex> guard(m_WriteLock);
+
+    const std::string prefix(pattern, strlen(pattern) - 1);
+    auto it = std::find_if(m_Patterns.begin(), m_Patterns.end(), [&](const PatternSubscription *subscription) {
+        return subscription->listener == listener && subscription->prefix == prefix;
+    });
+    if (it == m_Patterns.end())
         return false;
 
-    m_EventListeners[type].clear();
+    PatternSubscription *subscription = *it;
+    m_Patterns.erase(it);
+
+    const size_t count = m_EventTypeCount.load();
+    for (EventType type = 0; type < count; ++type) {
+        EventSlot *slot = GetSlot(type);
+        const ListenerTable *current = slot->listeners.load();
+        if (std::none_of(current->records.begin(), current->records.end(), [subscription](const ListenerRecord *record) {
+            return record->pattern == subscription;
+        }))
+            continue;
+
+        auto *table = new ListenerTable;
+        table->records.reserve(current->records.size());
+        for (auto *record: current->records) {
+            if (record->pattern == subscription) {
+                record->removed.store(true, std::memory_order_relaxed);
+                Retire(record);
+            } else {
+                table->records.push_back(record);
+            }
+        }
+        PublishListeners(*slot, table);
+    }
+    delete subscription;
+
+    Reclaim();
     return true;
 }
 
-EventManager::EventManager() = default;
+void EventManager::ApplyPatterns(EventSlot &slot) {
+    const char *name = slot.name.load();
+    const ListenerTable *current = slot.listeners.load();
 
+    // Rebuild the records created from patterns, the name may have moved in or out of a pattern.
+    auto *table = new ListenerTable;
+    table->records.reserve(current->records.size());
+    for (auto *record: current->records) {
+        if (record->pattern) {
+            record->removed.store(true, std::memory_order_relaxed);
+            Retire(record);
+        } else {
+            table->records.push_back(record);
+        }
+    }
+
+    for (auto *pattern: m_Patterns) {
+        if (MatchPattern(*pattern, name))
+            InsertRecord(table, new ListenerRecord(pattern->listener, pattern->priority, pattern->phase,
+                                                   pattern->flagMask, pattern->flagValue, pattern));
+    }
+    PublishListeners(slot, table);
+}
+
+void EventManager::InsertRecord(ListenerTable *table, ListenerRecord *record) {
+    // Keep the table sorted on insertion so that dispatch is a plain linear walk.
+    auto &records = table->records;
+    records.insert(std::upper_bound(records.begin(), records.end(), record,
+                                    [](const ListenerRecord *lhs, const ListenerRecord *rhs) {
+                                        return *lhs < *rhs;
+                                    }), record);
+}
+
+void EventManager::PublishListeners(EventSlot &slot, ListenerTable *table) {
+    table->flagMasks.resize(table->records.size());
+    table->flagValues.resize(table->records.size());
+    for (size_t i = 0; i < table->records.size(); ++i) {
+        table->flagMasks[i] = table->records[i]->flagMask;
+        table->flagValues[i] = table->records[i]->flagValue;
+    }
+
+    const ListenerTable *old = slot.listeners.exchange(table);
+    if (old)
+        Retire(old);
+}
+
+void EventManager::PublishNameTable(size_t capacity) {
+    auto *names = new NameTable;
+    names->buckets.assign(capacity, {0, 0});
+
+    const size_t mask = capacity - 1;
+    const size_t count = m_EventTypeCount.load();
+    for (EventType type = 0; type < count; ++type) {
+        uint32_t hash = GetSlot(type)->hash;
+        size_t i = hash & mask;
+        while (names->buckets[i].type != 0)
+            i = (i + 1) & mask;
+        names->buckets[i] = {type + 1, hash};
+    }
+
+    const NameTable *old = m_NameTable.exchange(names);
+    if (old)
+        Retire(old);
+}
+
+void EventManager::Retire(void *ptr, void (*deleter)(void *)) {
+    m_Retired.push_back({ptr, deleter, m_Epoch.load(std::memory_order_relaxed)});
+}
+
+void EventManager::RetireName(const char *name) {
+    if (name)
+        Retire(const_cast<char *>(name), [](void *p) { delete[] static_cast<char *>(p); });
+}
+
+void EventManager::Reclaim() {
+    // Retired objects may still be referenced by readers that loaded them before they were unpublished.
+    // Readers of the current epoch started after everything retired in earlier epochs was unpublished,
+    // so only the readers of the previous epoch have to be gone.
+    if (m_Retired.empty())
+        return;
+
+    const uint32_t epoch = m_Epoch.load();
+    if (m_Readers[(epoch - 1) & 1].load() != 0)
+        return;
+
+    auto it = m_Retired.begin();
+    for (; it != m_Retired.end() && it->epoch != epoch; ++it)
+        it->deleter(it->ptr);
+    m_Retired.erase(m_Retired.begin(), it);
+
+    // What was retired in this epoch is freed once its readers, now the previous ones, are gone.
+    m_Epoch.store(epoch + 1);
+}
+
+void EventManager::ClearPostedEvents() {
+    IEvent *event = nullptr;
+    while (m_PostedEvents.Pop(event)) {
+        m_PostedEventCount.fetch_sub(1, std::memory_order_relaxed);
+        event->Release();
+    }
+}
@@ -1,18 +1,28 @@
 #ifndef BALLOON_EVENTMANAGER_H
 #define BALLOON_EVENTMANAGER_H
 
+#include <atomic>
+#include <chrono>
+#include <mutex>
 #include <string>
 #include <vector>
-#include <unordered_map>
 
 #include "Balloon/IEventManager.h"
 #include "Event.h"
+#include "MpmcRing.h"
+#include "MpscQueue.h"
+#include "TimerWheel.h"
+#include "WorkerPool.h"
 
 namespace balloon {
+    class EventJournal;
+
     class EventManager final : public IEventManager {
     public:
         static EventManager &GetInstance();
 
+        EventManager();
+
         EventManager(const EventManager &rhs) = delete;
         EventManager(EventManager &&rhs) noexcept = delete;
 
@@ -45,16 +55,261 @@ namespace balloon {
         bool RemoveListener(EventType eventType, IEventListener *listener) override;
         bool RemoveListener(const char *eventName, IEventListener *listener) override;
 
+        bool AddAsyncListener(EventType eventType, IAsyncEventListener *listener) override;
+        bool RemoveAsyncListener(EventType eventType, IAsyncEventListener *listener) override;
+
         bool RemoveAllListeners(EventType eventType);
         bool RemoveAllListeners(const char *eventName);
 
+        bool PostEvent(IEvent *event) override;
+        bool PostEvent(EventType type) override;
+        bool PostEvent(const char *name) override;
+
+        bool SetEventCoalescing(EventType type, EventCoalesceMode mode, int keyIndex = -1,
+                                EventMergeCallback merge = nullptr, void *userdata = nullptr) override;
+
+        bool AddBatchListener(EventType eventType, IEventBatchListener *listener) override;
+        bool RemoveBatchListener(EventType eventType, IEventBatchListener *listener) override;
+
+        EventTimer ScheduleEvent(EventType type, uint32_t delay, EventTimerUnit unit = EVENT_TIMER_FRAMES,
+                                 bool repeat = false) override;
+        EventTimer ScheduleEvent(IEvent *event, uint32_t delay, EventTimerUnit unit = EVENT_TIMER_FRAMES,
+                                 bool repeat = false) override;
+        bool CancelScheduledEvent(EventTimer timer) override;
+
+        void DispatchEvents();
+        void UpdateTimers();
+
+        uint64_t GetFrame() const { return m_Frame.load(std::memory_order_relaxed); }
+
+        // Takes ownership of the journal, nullptr stops recording. The previous journal is closed
+        // and deleted once no sender is recording into it.
+        void SetJournal(EventJournal *journal);
+        bool HasJournal() const;
+
+        void GetEventPoolStats(EventPoolStats *stats) const override;
+
+        EventType GetEventTypeByHash(const char *name, uint32_t hash) const override;
+
+        bool AddListenerEx(EventType eventType, IEventListener *listener, int priority, EventPhase phase = EVENT_PHASE_NORMAL) override;
+        bool AddListenerEx(const char *eventName, IEventListener *listener, int priority, EventPhase phase = EVENT_PHASE_NORMAL) override;
+        bool AddFilteredListener(EventType eventType, IEventListener *listener, int priority, EventPhase phase,
+                                 int flagMask, int flagValue) override;
+        bool AddFilteredListener(const char *eventName, IEventListener *listener, int priority, EventPhase phase,
+                                 int flagMask, int flagValue) override;
+
     private:
-        EventManager();
+        struct ListenerRecord {
+            IEventListener *listener;
+            int priority;
+            EventPhase phase;
+            int flagMask;
+            int flagValue;
+            // The pattern subscription the record was created from, if any.
+            const void *pattern;
+            // Set on removal so that dispatches still walking an older table skip the listener.
+            std::atomic<bool> removed{false};
+
+            ListenerRecord(IEventListener *l, int prio, EventPhase ph, int mask, int value, const void *pat = nullptr)
+                : listener(l), priority(prio), phase(ph), flagMask(mask), flagValue(value & mask), pattern(pat) {}
+
+            bool operator<(const ListenerRecord &rhs) const {
+                if (phase != rhs.phase)
+                    return phase < rhs.phase;
+                return priority > rhs.priority;
+            }
+        };
+
+        // Listener and name tables are immutable once published and replaced as a whole on every change.
+        struct ListenerTable {
+            std::vector<ListenerRecord *> records;
+            // Flag filters of the records packed apart, so that dispatch skips non-matching listeners
+            // without touching the records.
+            std::vector<int> flagMasks;
+            std::vector<int> flagValues;
+        };
+
+        struct PatternSubscription {
+            std::string prefix;
+            IEventListener *listener;
+            int priority;
+            EventPhase phase;
+            int flagMask;
+            int flagValue;
+        };
+
+        struct AsyncListenerRecord {
+            IAsyncEventListener *listener;
+            // Held by the listener table and by every job in flight.
+            std::atomic<int> refs{1};
+            std::atomic<int> running{0};
+            std::atomic<bool> removed{false};
+
+            explicit AsyncListenerRecord(IAsyncEventListener *l) : listener(l) {}
+        };
+
+        struct AsyncListenerTable {
+            std::vector<AsyncListenerRecord *> records;
+        };
+
+        struct AsyncJob {
+            EventManager *manager;
+            AsyncListenerRecord *record;
+            IEvent *event;
+            int result;
+        };
+
+        struct BatchListenerTable {
+            std::vector<IEventBatchListener *> listeners;
+        };
+
+        struct CoalescePolicy {
+            EventCoalesceMode mode;
+            int keyIndex;
+            EventMergeCallback merge;
+            void *userdata;
+        };
+
+        struct CoalesceBucket {
+            size_t index; // Index in the frame events plus one, zero if the bucket is empty.
+            EventType type;
+            uint64_t key;
+        };
+
+        struct NameBucket {
+            EventType type; // Event type plus one, zero if the bucket is empty.
+            uint32_t hash;
+        };
+
+        struct NameTable {
+            std::vector<NameBucket> buckets;
+        };
+
+        struct EventSlot {
+            std::atomic<const char *> name{nullptr};
+            uint32_t hash = 0;
+            std::atomic<const ListenerTable *> listeners{nullptr};
+            std::atomic<const AsyncListenerTable *> asyncListeners{nullptr};
+            std::atomic<const BatchListenerTable *> batchListeners{nullptr};
+            std::atomic<const CoalescePolicy *> coalesce{nullptr};
+        };
+
+        struct RetiredObject {
+            void *ptr;
+            void (*deleter)(void *);
+            uint32_t epoch;
+        };
+
+        // Counts a lock-free reader in the epoch it started in while it holds pointers into published tables.
+        // Objects retired during an epoch are freed once the readers of that epoch are gone, so readers
+        // starting later never hold back reclamation.
+        class ReadGuard {
+        public:
+            explicit ReadGuard(const EventManager &manager) : m_Readers(manager.m_Readers) {
+                while (true) {
+                    uint32_t epoch = manager.m_Epoch.load();
+                    m_Parity = epoch & 1;
+                    m_Readers[m_Parity].fetch_add(1);
+                    // Reclaim does not wait for a reader counted in an epoch it has already moved past.
+                    if (manager.m_Epoch.load() == epoch)
+                        break;
+                    m_Readers[m_Parity].fetch_sub(1);
+                }
+            }
+            ~ReadGuard() { m_Readers[m_Parity].fetch_sub(1); }
+
+        private:
+            std::atomic<int> *m_Readers;
+            uint32_t m_Parity;
+        };
+
+        static constexpr size_t EVENT_SLOT_CHUNK_SIZE = 256;
+        static constexpr size_t EVENT_SLOT_CHUNK_COUNT = 256;
+        static constexpr size_t ASYNC_JOB_CACHE_SIZE = 256;
+
+        EventSlot *GetSlot(EventType type) const;
+        EventType FindEventType(const char *name, uint32_t hash) const;
+
+        void RecordEvent(const IEvent *event) const;
+        void DispatchEvent(EventSlot &slot, IEvent *event);
+        void InvokeListeners(EventSlot &slot, IEvent *event);
+        void InvokeListenersProfiled(EventSlot &slot, IEvent *event);
+        void RemoveListenerRecord(EventSlot &slot, ListenerRecord *record);
+
+        void SubmitAsyncJobs(EventSlot &slot, IEvent *event);
+        AsyncJob *AcquireAsyncJob();
+        void RecycleAsyncJob(AsyncJob *job);
+        static void RunAsyncJob(void *data);
+        void CompleteAsyncJobs(bool notify);
+        void RetireAsyncRecord(AsyncListenerRecord *record);
+        static void ReleaseAsyncRecord(AsyncListenerRecord *record);
+
+        void CoalesceEvents(std::vector<IEvent *> &events);
+        void DeliverBatches(const std::vector<IEvent *> &events);
+        void RemoveBatchListener(EventSlot &slot, IEventBatchListener *listener);
+        static uint64_t GetCoalesceKey(const IEvent *event, int keyIndex);
+
+        static bool IsPattern(const char *name);
+        static bool MatchPattern(const PatternSubscription &pattern, const char *name);
+        bool AddPatternListener(const char *pattern, IEventListener *listener, int priority, EventPhase phase,
+                                int flagMask, int flagValue);
+        bool RemovePatternListener(const char *pattern, IEventListener *listener);
+        void ApplyPatterns(EventSlot &slot);
+
+        static void InsertRecord(ListenerTable *table, ListenerRecord *record);
+        void PublishListeners(EventSlot &slot, ListenerTable *table);
+        void PublishNameTable(size_t capacity);
+
+        template<typename T>
+        void Retire(T *ptr) {
+            Retire(const_cast<void *>(static_cast<const void *>(ptr)), [](void *p) { delete static_cast<T *>(p); });
+        }
+        void Retire(void *ptr, void (*deleter)(void *));
+        void RetireName(const char *name);
+        void Reclaim();
+
+        uint64_t GetClockTicks();
+
+        void ClearPostedEvents();
+
+        // Readers of even and odd epochs.
+        mutable std::atomic<int> m_Readers[2] = {};
+        std::atomic<uint32_t> m_Epoch{0};
+        std::mutex m_WriteLock;
+        std::vector<RetiredObject> m_Retired;
+        // Names replaced by a rename stay valid until Reset, GetEventTypeName hands them out without a guard.
+        std::vector<const char *> m_RenamedNames;
+
+        std::atomic<size_t> m_EventTypeCount{0};
+        std::atomic<EventSlot *> m_EventSlots[EVENT_SLOT_CHUNK_COUNT] = {};
+        std::atomic<const NameTable *> m_NameTable{nullptr};
+        std::vector<PatternSubscription *> m_Patterns;
+
+        std::mutex m_TimerLock;
+        TimerWheel m_FrameTimers;
+        TimerWheel m_ClockTimers;
+        EventTimer m_NextTimer = 0;
+        bool m_ClockStarted = false;
+        std::chrono::steady_clock::time_point m_ClockStart;
+        uint64_t m_ClockTicks = 0;
+        std::vector<IEvent *> m_DueEvents;
+
+        WorkerPool m_Workers;
+        MpscQueue<AsyncJob *> m_CompletedJobs;
+        // Completed jobs kept for reuse, async deliveries do not allocate once warmed up.
+        MpmcRing<AsyncJob *> m_FreeJobs{ASYNC_JOB_CACHE_SIZE};
+
+        std::atomic<uint64_t> m_Frame{0};
+        std::atomic<EventJournal *> m_Journal{nullptr};
+
+        MpscQueue<IEvent *> m_PostedEvents;
+        std::atomic<size_t> m_PostedEventCount{0};
 
-        std::vector<bool> m_EventStatus;
-        std::vector<std::string> m_EventTypes;
-        std::unordered_map<std::string, EventType> m_EventTypeMap;
-        std::unordered_map<EventType, std::vector<IEventListener *>> m_EventListeners;
+        // Scratch buffers of DispatchEvents, kept to avoid allocating every frame.
+        std::vector<IEvent *> m_FrameEvents;
+        std::vector<CoalesceBucket> m_CoalesceTable;
+        std::vector<std::pair<EventType, size_t>> m_BatchOrder;
+        std::vector<const IEvent *> m_BatchEvents;
     };
 }
 
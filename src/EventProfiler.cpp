@@ -0,0 +1,305 @@
+#include "EventProfiler.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+#include "EventManager.h"
+#include "Logger.h"
+
+using namespace balloon;
+
+namespace {
+    const char *GetModuleName(const void *address, char *buf, size_t size) {
+#ifdef _WIN32
+        HMODULE module = nullptr;
+        if (GetModuleHandleExA(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+                               static_cast<LPCSTR>(address), &module) &&
+            GetModuleFileNameA(module, buf, static_cast<DWORD>(size)) != 0) {
+            const char *name = strrchr(buf, '\\');
+            return name ? name + 1 : buf;
+        }
+#endif
+        return "unknown";
+    }
+}
+
+std::atomic<bool> EventProfiler::s_Active{false};
+
+EventProfiler &EventProfiler::GetInstance() {
+    static EventProfiler instance;
+    return instance;
+}
+
+EventProfiler::~EventProfiler() {
+    for (auto *buffer: m_Buffers)
+        delete buffer;
+}
+
+void EventProfiler::SetEnabled(bool enabled) {
+    s_Active.store(enabled, std::memory_order_relaxed);
+}
+
+bool EventProfiler::IsEnabled() const {
+    return IsActive();
+}
+
+void EventProfiler::Reset() {
+    std::lock_guard<std::mutex> guard(m_Mutex);
+    for (auto *buffer: m_Buffers) {
+        std::lock_guard<std::mutex> bufferGuard(buffer->mutex);
+        buffer->samples.clear();
+    }
+    m_Stats.clear();
+    m_FrameCount = 0;
+}
+
+bool EventProfiler::GetEventProfile(EventType type, EventProfile *profile) const {
+    if (!profile)
+        return false;
+
+    Merge();
+    std::lock_guard<std::mutex> guard(m_Mutex);
+
+    if (type >= m_Stats.size() || m_Stats[type].sendCount == 0)
+        return false;
+
+    const TypeStats &stats = m_Stats[type];
+    profile->sendCount = stats.sendCount;
+    profile->totalTime = stats.totalTime;
+    profile->maxTime = stats.maxTime;
+    return true;
+}
+
+size_t EventProfiler::GetListenerProfileCount(EventType type) const {
+    Merge();
+    std::lock_guard<std::mutex> guard(m_Mutex);
+
+    if (type >= m_Stats.size())
+        return 0;
+    return m_Stats[type].listeners.size();
+}
+
+bool EventProfiler::GetListenerProfile(EventType type, size_t index, EventListenerProfile *profile) const {
+    if (!profile)
+        return false;
+
+    Merge();
+    std::lock_guard<std::mutex> guard(m_Mutex);
+
+    if (type >= m_Stats.size() || index >= m_Stats[type].listeners.size())
+        return false;
+
+    const ListenerStats &stats = m_Stats[type].listeners[index];
+    profile->listener = stats.listener;
+    profile->callCount = stats.callCount;
+    profile->totalTime = stats.totalTime;
+    profile->maxTime = stats.maxTime;
+    profile->p50 = GetPercentile(stats, 0.5);
+    profile->p99 = GetPercentile(stats, 0.99);
+    std::copy(std::begin(stats.buckets), std::end(stats.buckets), profile->buckets);
+    return true;
+}
+
+void EventProfiler::SetDumpInterval(uint32_t frames) {
+    m_DumpInterval.store(frames, std::memory_order_relaxed);
+}
+
+uint32_t EventProfiler::GetDumpInterval() const {
+    return m_DumpInterval.load(std::memory_order_relaxed);
+}
+
+void EventProfiler::Dump() const {
+    auto &em = EventManager::GetInstance();
+
+    Merge();
+    std::lock_guard<std::mutex> guard(m_Mutex);
+
+    // Most expensive event types first.
+    std::vector<EventType> types;
+    for (EventType type = 0; type < m_Stats.size(); ++type) {
+        if (m_Stats[type].sendCount != 0)
+            types.push_back(type);
+    }
+    std::sort(types.begin(), types.end(), [this](EventType lhs, EventType rhs) {
+        return m_Stats[lhs].totalTime > m_Stats[rhs].totalTime;
+    });
+
+    LOG_INFO("Event profile: %zu event types dispatched", types.size());
+
+    char module[260];
+    for (auto type: types) {
+        const TypeStats &stats = m_Stats[type];
+        const char *name = em.GetEventTypeName(type);
+        LOG_INFO("  %s: %zu sends, total %.3f ms, max %.3f ms", name ? name : "(unknown)",
+                 stats.sendCount, stats.totalTime / 1e6, stats.maxTime / 1e6);
+
+        for (auto &listener: stats.listeners) {
+            LOG_INFO("    %p (%s): %zu calls, total %.3f ms, p50 %.1f us, p99 %.1f us, max %.1f us",
+                     static_cast<void *>(listener.listener),
+                     GetModuleName(listener.vtable, module, sizeof(module)),
+                     listener.callCount, listener.totalTime / 1e6,
+                     GetPercentile(listener, 0.5) / 1e3, GetPercentile(listener, 0.99) / 1e3,
+                     listener.maxTime / 1e3);
+        }
+    }
+}
+
+void EventProfiler::RecordEvent(EventType type, uint64_t time) {
+    AddSample({type, nullptr, nullptr, time});
+}
+
+void EventProfiler::RecordListener(EventType type, IEventListener *listener, uint64_t time) {
+    // The vtable lives in the image of the module implementing the listener, which tells the mod apart
+    // even after the listener itself is gone.
+    AddSample({type, listener, *reinterpret_cast<const void *const *>(listener), time});
+}
+
+void EventProfiler::Update() {
+    Merge();
+
+    uint32_t interval = m_DumpInterval.load(std::memory_order_relaxed);
+    if (interval == 0 || !IsActive())
+        return;
+
+    if (++m_FrameCount >= interval) {
+        m_FrameCount = 0;
+        Dump();
+    }
+}
+
+EventProfiler::EventProfiler() {
+    m_MergeBuffer.reserve(MAX_PENDING_SAMPLES);
+}
+
+EventProfiler::ThreadBufferHandle::~ThreadBufferHandle() {
+    if (buffer) {
+        // The profiler owns the buffer, it frees it once the remaining samples are merged.
+        std::lock_guard<std::mutex> guard(buffer->mutex);
+        buffer->exited = true;
+    }
+}
+
+void EventProfiler::AddSample(const Sample &sample) {
+    ThreadBuffer *buffer = GetThreadBuffer();
+
+    size_t count;
+    {
+        std::lock_guard<std::mutex> guard(buffer->mutex);
+        buffer->samples.push_back(sample);
+        count = buffer->samples.size();
+    }
+
+    // Bound the memory held by threads dispatching many events between two frames.
+    if (count >= MAX_PENDING_SAMPLES)
+        Merge();
+}
+
+EventProfiler::ThreadBuffer *EventProfiler::GetThreadBuffer() {
+    thread_local ThreadBufferHandle handle;
+    if (!handle.buffer) {
+        auto *buffer = new ThreadBuffer;
+        buffer->samples.reserve(MAX_PENDING_SAMPLES);
+
+        std::lock_guard<std::mutex> guard(m_Mutex);
+        m_Buffers.push_back(buffer);
+        handle.buffer = buffer;
+    }
+    return handle.buffer;
+}
+
+void EventProfiler::Merge() const {
+    std::lock_guard<std::mutex> guard(m_Mutex);
+
+    for (size_t i = 0; i < m_Buffers.size();) {
+        ThreadBuffer *buffer = m_Buffers[i];
+        bool exited;
+        {
+            // Swap so that both vectors keep their capacity and recording does not allocate.
+            std::lock_guard<std::mutex> bufferGuard(buffer->mutex);
+            m_MergeBuffer.swap(buffer->samples);
+            exited = buffer->exited;
+        }
+
+        for (const Sample &sample: m_MergeBuffer) {
+            TypeStats &stats = GetStats(sample.type);
+            if (!sample.listener) {
+                ++stats.sendCount;
+                stats.totalTime += sample.time;
+                stats.maxTime = std::max(stats.maxTime, sample.time);
+                continue;
+            }
+
+            auto &listeners = stats.listeners;
+            auto it = std::find_if(listeners.begin(), listeners.end(), [&sample](const ListenerStats &s) {
+                return s.listener == sample.listener;
+            });
+            if (it == listeners.end()) {
+                listeners.emplace_back();
+                it = listeners.end() - 1;
+                it->listener = sample.listener;
+                it->vtable = sample.vtable;
+            }
+
+            ++it->callCount;
+            it->totalTime += sample.time;
+            it->maxTime = std::max(it->maxTime, sample.time);
+            ++it->buckets[GetBucketIndex(sample.time)];
+        }
+        m_MergeBuffer.clear();
+
+        if (exited) {
+            delete buffer;
+            m_Buffers.erase(m_Buffers.begin() + static_cast<ptrdiff_t>(i));
+        } else {
+            ++i;
+        }
+    }
+}
+
+size_t EventProfiler::GetBucketIndex(uint64_t time) {
+    if (time < EVENT_PROFILER_SUB_BUCKET_COUNT)
+        return static_cast<size_t>(time);
+
+    size_t msb = 0;
+    for (uint64_t t = time; t >>= 1;)
+        ++msb;
+
+    // The two bits below the most significant one select the sub-bucket.
+    size_t sub = static_cast<size_t>(time >> (msb - 2)) & (EVENT_PROFILER_SUB_BUCKET_COUNT - 1);
+    size_t index = (msb - 1) * EVENT_PROFILER_SUB_BUCKET_COUNT + sub;
+    return std::min(index, static_cast<size_t>(EVENT_PROFILER_BUCKET_COUNT - 1));
+}
+
+uint64_t EventProfiler::GetBucketUpperBound(size_t index) {
+    if (index < EVENT_PROFILER_SUB_BUCKET_COUNT)
+        return index;
+
+    size_t msb = index / EVENT_PROFILER_SUB_BUCKET_COUNT + 1;
+    size_t sub = index % EVENT_PROFILER_SUB_BUCKET_COUNT;
+    uint64_t lower = static_cast<uint64_t>(EVENT_PROFILER_SUB_BUCKET_COUNT + sub) << (msb - 2);
+    return lower + (static_cast<uint64_t>(1) << (msb - 2)) - 1;
+}
+
+uint64_t EventProfiler::GetPercentile(const ListenerStats &stats, double percentile) {
+    if (stats.callCount == 0)
+        return 0;
+
+    auto threshold = static_cast<uint64_t>(percentile * static_cast<double>(stats.callCount));
+    uint64_t count = 0;
+    for (size_t i = 0; i < EVENT_PROFILER_BUCKET_COUNT; ++i) {
+        count += stats.buckets[i];
+        if (count > threshold)
+            return std::min(GetBucketUpperBound(i), stats.maxTime);
+    }
+    return stats.maxTime;
+}
+
+EventProfiler::TypeStats &EventProfiler::GetStats(EventType type) const {
+    if (type >= m_Stats.size())
+        m_Stats.resize(type + 1);
+    return m_Stats[type];
+}
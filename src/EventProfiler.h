@@ -0,0 +1,114 @@
+#ifndef BALLOON_EVENTPROFILER_H
+#define BALLOON_EVENTPROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+#include "Balloon/IEventProfiler.h"
+
+namespace balloon {
+    class EventProfiler final : public IEventProfiler {
+    public:
+        static EventProfiler &GetInstance();
+
+        static bool IsActive() { return s_Active.load(std::memory_order_relaxed); }
+
+        static uint64_t Now() {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        EventProfiler(const EventProfiler &rhs) = delete;
+        EventProfiler(EventProfiler &&rhs) noexcept = delete;
+
+        ~EventProfiler();
+
+        EventProfiler &operator=(const EventProfiler &rhs) = delete;
+        EventProfiler &operator=(EventProfiler &&rhs) noexcept = delete;
+
+        void SetEnabled(bool enabled) override;
+        bool IsEnabled() const override;
+
+        void Reset() override;
+
+        bool GetEventProfile(EventType type, EventProfile *profile) const override;
+        size_t GetListenerProfileCount(EventType type) const override;
+        bool GetListenerProfile(EventType type, size_t index, EventListenerProfile *profile) const override;
+
+        void SetDumpInterval(uint32_t frames) override;
+        uint32_t GetDumpInterval() const override;
+
+        void Dump() const override;
+
+        void RecordEvent(EventType type, uint64_t time);
+        void RecordListener(EventType type, IEventListener *listener, uint64_t time);
+
+        void Update();
+
+    private:
+        struct ListenerStats {
+            IEventListener *listener = nullptr;
+            const void *vtable = nullptr;
+            size_t callCount = 0;
+            uint64_t totalTime = 0;
+            uint64_t maxTime = 0;
+            uint32_t buckets[EVENT_PROFILER_BUCKET_COUNT] = {};
+        };
+
+        struct TypeStats {
+            size_t sendCount = 0;
+            uint64_t totalTime = 0;
+            uint64_t maxTime = 0;
+            std::vector<ListenerStats> listeners;
+        };
+
+        // A dispatch of an event type when listener is null, a listener call otherwise.
+        struct Sample {
+            EventType type;
+            IEventListener *listener;
+            const void *vtable;
+            uint64_t time;
+        };
+
+        // Samples recorded by one thread since the last merge. Only that thread and the merge touch it,
+        // so recording never contends with other dispatching threads.
+        struct ThreadBuffer {
+            std::mutex mutex;
+            std::vector<Sample> samples;
+            bool exited = false;
+        };
+
+        struct ThreadBufferHandle {
+            ThreadBuffer *buffer = nullptr;
+            ~ThreadBufferHandle();
+        };
+
+        static constexpr size_t MAX_PENDING_SAMPLES = 1024;
+
+        EventProfiler();
+
+        void AddSample(const Sample &sample);
+        ThreadBuffer *GetThreadBuffer();
+        void Merge() const;
+
+        static size_t GetBucketIndex(uint64_t time);
+        static uint64_t GetBucketUpperBound(size_t index);
+        static uint64_t GetPercentile(const ListenerStats &stats, double percentile);
+
+        TypeStats &GetStats(EventType type) const;
+
+        static std::atomic<bool> s_Active;
+
+        // Samples are merged into the statistics by Update and before any query, under this lock.
+        mutable std::mutex m_Mutex;
+        mutable std::vector<TypeStats> m_Stats;
+        mutable std::vector<ThreadBuffer *> m_Buffers;
+        mutable std::vector<Sample> m_MergeBuffer;
+        std::atomic<uint32_t> m_DumpInterval{0};
+        uint32_t m_FrameCount = 0;
+    };
+}
+
+#endif // BALLOON_EVENTPROFILER_H
@@ -0,0 +1,70 @@
+#include "EventRecorder.h"
+
+#include "EventJournal.h"
+#include "EventManager.h"
+#include "Logger.h"
+
+using namespace balloon;
+
+EventRecorder &EventRecorder::GetInstance() {
+    static EventRecorder instance;
+    return instance;
+}
+
+EventRecorder::~EventRecorder() {
+    StopReplay();
+}
+
+bool EventRecorder::StartRecording(const char *path) {
+    auto *journal = new EventJournal();
+    if (!journal->Open(path)) {
+        delete journal;
+        return false;
+    }
+
+    EventManager::GetInstance().SetJournal(journal);
+    return true;
+}
+
+void EventRecorder::StopRecording() {
+    EventManager::GetInstance().SetJournal(nullptr);
+}
+
+bool EventRecorder::IsRecording() const {
+    return EventManager::GetInstance().HasJournal();
+}
+
+bool EventRecorder::StartReplay(const char *path, bool nested) {
+    auto *replayer = new EventReplayer(EventManager::GetInstance(), nested);
+    if (!replayer->Open(path)) {
+        delete replayer;
+        return false;
+    }
+
+    StopReplay();
+    m_Replayer = replayer;
+    return true;
+}
+
+void EventRecorder::StopReplay() {
+    delete m_Replayer;
+    m_Replayer = nullptr;
+}
+
+bool EventRecorder::IsReplaying() const {
+    return m_Replayer != nullptr;
+}
+
+void EventRecorder::Update() {
+    if (!m_Replayer)
+        return;
+
+    if (!m_Replayer->ReplayFrame()) {
+        if (m_Replayer->HasError())
+            LOG_WARN("Event replay stopped at frame %llu: the journal is truncated or corrupt",
+                     static_cast<unsigned long long>(m_Replayer->GetFrame()));
+        StopReplay();
+    }
+}
+
+EventRecorder::EventRecorder() = default;
@@ -0,0 +1,38 @@
+#ifndef BALLOON_EVENTRECORDER_H
+#define BALLOON_EVENTRECORDER_H
+
+#include "Balloon/IEventJournal.h"
+
+namespace balloon {
+    class EventReplayer;
+
+    class EventRecorder final : public IEventJournal {
+    public:
+        static EventRecorder &GetInstance();
+
+        EventRecorder(const EventRecorder &rhs) = delete;
+        EventRecorder(EventRecorder &&rhs) noexcept = delete;
+
+        ~EventRecorder();
+
+        EventRecorder &operator=(const EventRecorder &rhs) = delete;
+        EventRecorder &operator=(EventRecorder &&rhs) noexcept = delete;
+
+        bool StartRecording(const char *path) override;
+        void StopRecording() override;
+        bool IsRecording() const override;
+
+        bool StartReplay(const char *path, bool nested = false) override;
+        void StopReplay() override;
+        bool IsReplaying() const override;
+
+        void Update();
+
+    private:
+        EventRecorder();
+
+        EventReplayer *m_Replayer = nullptr;
+    };
+}
+
+#endif // BALLOON_EVENTRECORDER_H
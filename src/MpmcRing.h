@@ -0,0 +1,104 @@
+#ifndef BALLOON_MPMCRING_H
+#define BALLOON_MPMCRING_H
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+namespace balloon {
+    /**
+     * @brief Bounded lock-free multi-producer multi-consumer queue.
+     *
+     * Each cell carries a sequence number telling whether it is ready to be written or read
+     * for the current lap, so producers and consumers only contend on their own index.
+     */
+    template<typename T>
+    class MpmcRing final {
+    public:
+        explicit MpmcRing(size_t capacity) {
+            size_t size = 2;
+            while (size < capacity)
+                size <<= 1;
+
+            m_Cells = new Cell[size];
+            m_Mask = size - 1;
+            for (size_t i = 0; i < size; ++i)
+                m_Cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+
+        MpmcRing(const MpmcRing &rhs) = delete;
+        MpmcRing(MpmcRing &&rhs) noexcept = delete;
+
+        ~MpmcRing() {
+            delete[] m_Cells;
+        }
+
+        MpmcRing &operator=(const MpmcRing &rhs) = delete;
+        MpmcRing &operator=(MpmcRing &&rhs) noexcept = delete;
+
+        bool Push(T value) {
+            size_t pos = m_Enqueue.load(std::memory_order_relaxed);
+            Cell *cell;
+            while (true) {
+                cell = &m_Cells[pos & m_Mask];
+                size_t seq = cell->sequence.load(std::memory_order_acquire);
+                auto diff = static_cast<ptrdiff_t>(seq) - static_cast<ptrdiff_t>(pos);
+                if (diff == 0) {
+                    if (m_Enqueue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        break;
+                } else if (diff < 0) {
+                    return false;
+                } else {
+                    pos = m_Enqueue.load(std::memory_order_relaxed);
+                }
+            }
+
+            cell->value = std::move(value);
+            cell->sequence.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool Pop(T &value) {
+            size_t pos = m_Dequeue.load(std::memory_order_relaxed);
+            Cell *cell;
+            while (true) {
+                cell = &m_Cells[pos & m_Mask];
+                size_t seq = cell->sequence.load(std::memory_order_acquire);
+                auto diff = static_cast<ptrdiff_t>(seq) - static_cast<ptrdiff_t>(pos + 1);
+                if (diff == 0) {
+                    if (m_Dequeue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        break;
+                } else if (diff < 0) {
+                    return false;
+                } else {
+                    pos = m_Dequeue.load(std::memory_order_relaxed);
+                }
+            }
+
+            value = std::move(cell->value);
+            cell->sequence.store(pos + m_Mask + 1, std::memory_order_release);
+            return true;
+        }
+
+        size_t Capacity() const {
+            return m_Mask + 1;
+        }
+
+    private:
+        struct Cell {
+            std::atomic<size_t> sequence;
+            T value{};
+        };
+
+        Cell *m_Cells;
+        size_t m_Mask;
+
+        // Keep the two indices on separate cache lines.
+        char m_Padding0[64];
+        std::atomic<size_t> m_Enqueue{0};
+        char m_Padding1[64];
+        std::atomic<size_t> m_Dequeue{0};
+    };
+}
+
+#endif // BALLOON_MPMCRING_H
@@ -0,0 +1,88 @@
+#ifndef BALLOON_MPSCQUEUE_H
+#define BALLOON_MPSCQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+#include "MpmcRing.h"
+
+namespace balloon {
+    /**
+     * @brief Unbounded lock-free multi-producer single-consumer queue.
+     *
+     * Push may be called from any thread, Pop must only be called from the consumer thread.
+     * Popped nodes are kept in a bounded free list for later pushes, so a queue whose length
+     * stays under the cache size does not allocate once warmed up.
+     */
+    template<typename T>
+    class MpscQueue final {
+    public:
+        static constexpr size_t DEFAULT_CACHE_SIZE = 256;
+
+        explicit MpscQueue(size_t cacheSize = DEFAULT_CACHE_SIZE) : m_FreeNodes(cacheSize) {
+            auto *stub = new Node;
+            m_Head.store(stub, std::memory_order_relaxed);
+            m_Tail = stub;
+        }
+
+        MpscQueue(const MpscQueue &rhs) = delete;
+        MpscQueue(MpscQueue &&rhs) noexcept = delete;
+
+        ~MpscQueue() {
+            T value;
+            while (Pop(value))
+                continue;
+            delete m_Tail;
+
+            Node *node;
+            while (m_FreeNodes.Pop(node))
+                delete node;
+        }
+
+        MpscQueue &operator=(const MpscQueue &rhs) = delete;
+        MpscQueue &operator=(MpscQueue &&rhs) noexcept = delete;
+
+        void Push(T value) {
+            Node *node;
+            if (m_FreeNodes.Pop(node))
+                node->next.store(nullptr, std::memory_order_relaxed);
+            else
+                node = new Node;
+            node->value = std::move(value);
+            Node *prev = m_Head.exchange(node, std::memory_order_acq_rel);
+            prev->next.store(node, std::memory_order_release);
+        }
+
+        bool Pop(T &value) {
+            Node *tail = m_Tail;
+            Node *next = tail->next.load(std::memory_order_acquire);
+            if (!next)
+                return false;
+
+            value = std::move(next->value);
+            m_Tail = next;
+
+            // The producer which linked next is done with tail, nothing refers to it anymore.
+            if (!m_FreeNodes.Push(tail))
+                delete tail;
+            return true;
+        }
+
+        bool Empty() const {
+            return m_Tail->next.load(std::memory_order_acquire) == nullptr;
+        }
+
+    private:
+        struct Node {
+            std::atomic<Node *> next{nullptr};
+            T value{};
+        };
+
+        std::atomic<Node *> m_Head;
+        Node *m_Tail;
+        MpmcRing<Node *> m_FreeNodes;
+    };
+}
+
+#endif // BALLOON_MPSCQUEUE_H
@@ -0,0 +1,155 @@
+#include "TimerWheel.h"
+
+using namespace balloon;
+
+TimerWheel::TimerWheel() {
+    for (auto &level: m_Slots)
+        for (auto &slot: level)
+            InitList(&slot);
+}
+
+TimerWheel::~TimerWheel() {
+    Clear();
+}
+
+void TimerWheel::Add(EventTimer id, IEvent *event, uint32_t delay, uint32_t period) {
+    if (delay == 0)
+        delay = 1;
+
+    auto *timer = new Timer;
+    timer->id = id;
+    timer->event = event;
+    // m_Now is the next tick to be processed, so a delay of one fires on the next advance.
+    timer->expires = m_Now + delay - 1;
+    timer->period = period;
+
+    m_Timers[id] = timer;
+    Schedule(timer);
+}
+
+bool TimerWheel::Cancel(EventTimer id) {
+    auto it = m_Timers.find(id);
+    if (it == m_Timers.end())
+        return false;
+
+    Timer *timer = it->second;
+    m_Timers.erase(it);
+    Unlink(timer);
+    Destroy(timer);
+    return true;
+}
+
+void TimerWheel::Clear() {
+    for (auto &entry: m_Timers) {
+        Unlink(entry.second);
+        Destroy(entry.second);
+    }
+    m_Timers.clear();
+}
+
+void TimerWheel::Advance(uint64_t ticks, std::vector<IEvent *> &due) {
+    Node expired;
+    while (ticks-- != 0) {
+        const uint32_t index = static_cast<uint32_t>(m_Now & LEVEL_MASK);
+
+        // Entering a new round of a level pulls the timers of the matching slot one level down.
+        if (index == 0) {
+            for (uint32_t level = 1; level < LEVEL_COUNT; ++level) {
+                auto slot = static_cast<uint32_t>((m_Now >> (level * LEVEL_BITS)) & LEVEL_MASK);
+                if (Cascade(level, slot))
+                    break;
+            }
+        }
+        ++m_Now;
+
+        if (IsEmpty(&m_Slots[0][index]))
+            continue;
+
+        // Move the slot aside first, repeating timers are rescheduled while walking it.
+        InitList(&expired);
+        Node &slot = m_Slots[0][index];
+        expired.next = slot.next;
+        expired.prev = slot.prev;
+        expired.next->prev = &expired;
+        expired.prev->next = &expired;
+        InitList(&slot);
+
+        while (!IsEmpty(&expired)) {
+            auto *timer = static_cast<Timer *>(expired.next);
+            Unlink(timer);
+
+            if (timer->period != 0) {
+                timer->event->AddRef();
+                due.push_back(timer->event);
+                timer->expires += timer->period;
+                Schedule(timer);
+            } else {
+                // The reference of the timer is handed over to the caller.
+                due.push_back(timer->event);
+                m_Timers.erase(timer->id);
+                delete timer;
+            }
+        }
+    }
+}
+
+void TimerWheel::InitList(Node *list) {
+    list->prev = list;
+    list->next = list;
+}
+
+bool TimerWheel::IsEmpty(const Node *list) {
+    return list->next == list;
+}
+
+void TimerWheel::Link(Node *list, Node *node) {
+    node->prev = list->prev;
+    node->next = list;
+    list->prev->next = node;
+    list->prev = node;
+}
+
+void TimerWheel::Unlink(Node *node) {
+    node->prev->next = node->next;
+    node->next->prev = node->prev;
+    node->prev = node;
+    node->next = node;
+}
+
+void TimerWheel::Schedule(Timer *timer) {
+    uint64_t delta = timer->expires - m_Now;
+    if (static_cast<int64_t>(delta) < 0) {
+        // Already due, fire on the next tick.
+        timer->expires = m_Now;
+        delta = 0;
+    } else if (delta > MAX_DELAY) {
+        // Out of reach of the wheel, park the timer in the last top level slot to be cascaded.
+        // It is rescheduled from there with what remains of its delay.
+        auto index = static_cast<uint32_t>(((m_Now + MAX_DELAY) >> ((LEVEL_COUNT - 1) * LEVEL_BITS)) & LEVEL_MASK);
+        Link(&m_Slots[LEVEL_COUNT - 1][index], timer);
+        return;
+    }
+
+    uint32_t level = 0;
+    while (level + 1 < LEVEL_COUNT && delta >= (static_cast<uint64_t>(1) << ((level + 1) * LEVEL_BITS)))
+        ++level;
+
+    auto index = static_cast<uint32_t>((timer->expires >> (level * LEVEL_BITS)) & LEVEL_MASK);
+    Link(&m_Slots[level][index], timer);
+}
+
+bool TimerWheel::Cascade(uint32_t level, uint32_t index) {
+    Node &slot = m_Slots[level][index];
+    while (!IsEmpty(&slot)) {
+        auto *timer = static_cast<Timer *>(slot.next);
+        Unlink(timer);
+        Schedule(timer);
+    }
+    // Only a wrapped level carries the cascade on to the next one.
+    return index != 0;
+}
+
+void TimerWheel::Destroy(Timer *timer) {
+    timer->event->Release();
+    delete timer;
+}
@@ -0,0 +1,72 @@
+#ifndef BALLOON_TIMERWHEEL_H
+#define BALLOON_TIMERWHEEL_H
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "Balloon/IEventManager.h"
+
+namespace balloon {
+    /**
+     * @brief Hierarchical timer wheel holding scheduled events.
+     *
+     * Five levels of 64 slots cover 2^30 ticks. Each tick only looks at one slot of the first level,
+     * timers of the upper levels are cascaded down once every 64^n ticks. Longer delays are parked
+     * in the top level and rescheduled each time their slot is cascaded, so they never fire early.
+     */
+    class TimerWheel final {
+    public:
+        TimerWheel();
+
+        TimerWheel(const TimerWheel &rhs) = delete;
+        TimerWheel(TimerWheel &&rhs) noexcept = delete;
+
+        ~TimerWheel();
+
+        TimerWheel &operator=(const TimerWheel &rhs) = delete;
+        TimerWheel &operator=(TimerWheel &&rhs) noexcept = delete;
+
+        void Add(EventTimer id, IEvent *event, uint32_t delay, uint32_t period);
+        bool Cancel(EventTimer id);
+        void Clear();
+
+        size_t Size() const { return m_Timers.size(); }
+
+        void Advance(uint64_t ticks, std::vector<IEvent *> &due);
+
+    private:
+        static constexpr uint32_t LEVEL_BITS = 6;
+        static constexpr uint32_t LEVEL_SIZE = 1 << LEVEL_BITS;
+        static constexpr uint32_t LEVEL_MASK = LEVEL_SIZE - 1;
+        static constexpr uint32_t LEVEL_COUNT = 5;
+        static constexpr uint64_t MAX_DELAY = (static_cast<uint64_t>(1) << (LEVEL_BITS * LEVEL_COUNT)) - 1;
+
+        struct Node {
+            Node *prev;
+            Node *next;
+        };
+
+        struct Timer : Node {
+            EventTimer id;
+            IEvent *event;
+            uint64_t expires;
+            uint32_t period;
+        };
+
+        static void InitList(Node *list);
+        static bool IsEmpty(const Node *list);
+        static void Link(Node *list, Node *node);
+        static void Unlink(Node *node);
+
+        void Schedule(Timer *timer);
+        bool Cascade(uint32_t level, uint32_t index);
+        void Destroy(Timer *timer);
+
+        uint64_t m_Now = 0;
+        Node m_Slots[LEVEL_COUNT][LEVEL_SIZE];
+        std::unordered_map<EventTimer, Timer *> m_Timers;
+    };
+}
+
+#endif // BALLOON_TIMERWHEEL_H
@@ -1,158 +1,47 @@
 #include "Variant.h"
 
 #include <cstdlib>
+#include <new>
+
+#include "Balloon/RefCount.h"
 
 using namespace balloon;
 
+namespace {
+    // Header in front of shared heap payloads, sized to keep the payload 8-byte aligned.
+    struct VariantBlock {
+        RefCount refs;
+        uint32_t reserved;
+    };
+
+    static_assert(sizeof(VariantBlock) % 8 == 0, "VariantBlock must keep payloads aligned");
+
+    // Control block of a buffer owned by the caller, shared by every cell referencing it.
+    struct VariantExternal {
+        RefCount refs;
+        void *data;
+        VariantRelease release;
+        void *userdata;
+    };
+
+    VariantBlock *GetBlock(void *data) {
+        return reinterpret_cast<VariantBlock *>(static_cast<char *>(data) - sizeof(VariantBlock));
+    }
+}
+
 Variant::Variant() = default;
 
 Variant::Variant(const void *buf, size_t size) {
-    if (buf && size != 0) {
-        SetType(VAR_TYPE_BUF, VAR_SUBTYPE_NONE);
-        m_Size = size;
-        m_Value.buf = malloc(size);
-        if (m_Value.buf) {
-            memcpy(m_Value.buf, buf, m_Size);
-            return;
-        }
-    }
-    Clear();
+    SetBuffer(buf, size);
 }
 
 Variant::Variant(const Variant &rhs) {
-    switch (GetType()) {
-        case VAR_TYPE_BOOL:
-            SetType(VAR_TYPE_BOOL, rhs.GetSubtype());
-            break;
-        case VAR_TYPE_CHAR:
-            *this = rhs.m_Value.c;
-            break;
-        case VAR_TYPE_NUM:
-            switch (GetSubtype()) {
-                case VAR_SUBTYPE_UINT8:
-                    *this = rhs.GetUint8();
-                    break;
-                case VAR_SUBTYPE_INT8:
-                    *this = rhs.GetInt8();
-                    break;
-                case VAR_SUBTYPE_UINT16:
-                    *this = rhs.GetUint16();
-                    break;
-                case VAR_SUBTYPE_INT16:
-                    *this = rhs.GetInt16();
-                    break;
-                case VAR_SUBTYPE_UINT32:
-                    *this = rhs.GetUint32();
-                    break;
-                case VAR_SUBTYPE_INT32:
-                    *this = rhs.GetInt32();
-                    break;
-                case VAR_SUBTYPE_UINT64:
-                    *this = rhs.GetUint64();
-                    break;
-                case VAR_SUBTYPE_INT64:
-                    *this = rhs.GetInt64();
-                    break;
-                case VAR_SUBTYPE_FLOAT32:
-                    *this = rhs.GetFloat32();
-                    break;
-                case VAR_SUBTYPE_FLOAT64:
-                    *this = rhs.GetFloat64();
-                    break;
-                default:
-                    break;
-            }
-        case VAR_TYPE_STR:
-            *this = rhs.m_Value.str;
-            break;
-        case VAR_TYPE_BUF:
-            Clear();
-            SetType(VAR_TYPE_BUF, VAR_TYPE_NONE);
-            m_Size = rhs.m_Size;
-            m_Value.buf = (uint8_t *) malloc(rhs.m_Size);
-            if (m_Value.buf) {
-                memcpy(m_Value.buf, rhs.m_Value.buf, m_Size);
-            } else {
-                Clear();
-            }
-            break;
-        case VAR_TYPE_PTR:
-            m_Size = rhs.m_Size;
-            m_Value.ptr = rhs.m_Value.ptr;
-            break;
-        default:
-            break;
-    }
+    *this = rhs;
 }
 
 Variant::Variant(Variant &&rhs) noexcept {
-    switch (GetType()) {
-        case VAR_TYPE_BOOL:
-            SetType(VAR_TYPE_BOOL, rhs.GetSubtype());
-            break;
-        case VAR_TYPE_CHAR:
-            *this = rhs.m_Value.c;
-            break;
-        case VAR_TYPE_NUM:
-            switch (GetSubtype()) {
-                case VAR_SUBTYPE_UINT8:
-                    *this = rhs.GetUint8();
-                    break;
-                case VAR_SUBTYPE_INT8:
-                    *this = rhs.GetInt8();
-                    break;
-                case VAR_SUBTYPE_UINT16:
-                    *this = rhs.GetUint16();
-                    break;
-                case VAR_SUBTYPE_INT16:
-                    *this = rhs.GetInt16();
-                    break;
-                case VAR_SUBTYPE_UINT32:
-                    *this = rhs.GetUint32();
-                    break;
-                case VAR_SUBTYPE_INT32:
-                    *this = rhs.GetInt32();
-                    break;
-                case VAR_SUBTYPE_UINT64:
-                    *this = rhs.GetUint64();
-                    break;
-                case VAR_SUBTYPE_INT64:
-                    *this = rhs.GetInt64();
-                    break;
-                case VAR_SUBTYPE_FLOAT32:
-                    *this = rhs.GetFloat32();
-                    break;
-                case VAR_SUBTYPE_FLOAT64:
-                    *this = rhs.GetFloat64();
-                    break;
-                default:
-                    break;
-            }
-        case VAR_TYPE_STR:
-            Clear();
-            SetType(VAR_TYPE_STR, VAR_TYPE_NONE);
-            m_Size = rhs.m_Size;
-            m_Value.str = rhs.m_Value.str;
-            rhs.SetType(VAR_TYPE_NONE, VAR_TYPE_NONE);
-            rhs.m_Size = 0;
-            rhs.m_Value.str = nullptr;
-            break;
-        case VAR_TYPE_BUF:
-            Clear();
-            SetType(VAR_TYPE_BUF, VAR_TYPE_NONE);
-            m_Size = rhs.m_Size;
-            m_Value.buf = rhs.m_Value.buf;
-            rhs.SetType(VAR_TYPE_NONE, VAR_TYPE_NONE);
-            rhs.m_Size = 0;
-            rhs.m_Value.buf = nullptr;
-            break;
-        case VAR_TYPE_PTR:
-            m_Size = rhs.m_Size;
-            m_Value.ptr = rhs.m_Value.ptr;
-            break;
-        default:
-            break;
-    }
+    CopyCell(rhs);
+    rhs.ResetCell();
 }
 
 Variant::~Variant() {
@@ -160,202 +49,80 @@ Variant::~Variant() {
 }
 
 Variant &Variant::operator=(const Variant &rhs) {
-    if (*this == rhs)
+    if (this == &rhs)
         return *this;
 
-    switch (GetType()) {
-        case VAR_TYPE_BOOL:
-            SetType(VAR_TYPE_BOOL, rhs.GetSubtype());
-            break;
-        case VAR_TYPE_CHAR:
-            *this = rhs.m_Value.c;
-            break;
-        case VAR_TYPE_NUM:
-            switch (GetSubtype()) {
-                case VAR_SUBTYPE_UINT8:
-                    *this = rhs.GetUint8();
-                    break;
-                case VAR_SUBTYPE_INT8:
-                    *this = rhs.GetInt8();
-                    break;
-                case VAR_SUBTYPE_UINT16:
-                    *this = rhs.GetUint16();
-                    break;
-                case VAR_SUBTYPE_INT16:
-                    *this = rhs.GetInt16();
-                    break;
-                case VAR_SUBTYPE_UINT32:
-                    *this = rhs.GetUint32();
-                    break;
-                case VAR_SUBTYPE_INT32:
-                    *this = rhs.GetInt32();
-                    break;
-                case VAR_SUBTYPE_UINT64:
-                    *this = rhs.GetUint64();
-                    break;
-                case VAR_SUBTYPE_INT64:
-                    *this = rhs.GetInt64();
-                    break;
-                case VAR_SUBTYPE_FLOAT32:
-                    *this = rhs.GetFloat32();
-                    break;
-                case VAR_SUBTYPE_FLOAT64:
-                    *this = rhs.GetFloat64();
-                    break;
-                default:
-                    break;
-            }
-        case VAR_TYPE_STR:
-            *this = rhs.m_Value.str;
-            break;
-        case VAR_TYPE_BUF: {
-            auto *buf = (uint8_t *) malloc(rhs.m_Size);
-            if (buf) {
-                Clear();
-                SetType(VAR_TYPE_BUF, VAR_SUBTYPE_NONE);
-                m_Size = rhs.m_Size;
-                m_Value.buf = buf;
-                memcpy(m_Value.buf, rhs.m_Value.buf, m_Size);
-            }
-        }
-            break;
-        case VAR_TYPE_PTR:
-            m_Size = rhs.m_Size;
-            m_Value.ptr = rhs.m_Value.ptr;
-            break;
-        default:
-            break;
+    if (rhs.IsArena()) {
+        Assign(rhs.GetType(), rhs.m_Value.ptr, rhs.m_Size);
+        return *this;
     }
 
+    // Retain first, this cell may hold another reference of the same block.
+    if (rhs.HasHeapData())
+        RetainBlock(rhs.m_Value.ptr);
+    else if (rhs.IsExternal())
+        RetainExternal(rhs.m_Value.ptr);
+
+    Clear();
+    CopyCell(rhs);
     return *this;
 }
 
 Variant &Variant::operator=(const char *value) {
-    if (value) {
-        char *str = strdup(value);
-        if (str) {
-            Clear();
-            SetType(VAR_TYPE_STR, VAR_TYPE_NONE);
-            m_Size = strlen(str);
-            m_Value.str = str;
-        }
-    }
+    if (value)
+        Assign(VAR_TYPE_STR, value, strlen(value));
     return *this;
 }
 
 Variant &Variant::operator=(Variant &&rhs) noexcept {
-    if (*this == rhs)
+    if (this == &rhs)
         return *this;
 
-    switch (GetType()) {
-        case VAR_TYPE_BOOL:
-            SetType(VAR_TYPE_BOOL, rhs.GetSubtype());
-            break;
-        case VAR_TYPE_CHAR:
-            *this = rhs.m_Value.c;
-            break;
-        case VAR_TYPE_NUM:
-            switch (GetSubtype()) {
-                case VAR_SUBTYPE_UINT8:
-                    *this = rhs.GetUint8();
-                    break;
-                case VAR_SUBTYPE_INT8:
-                    *this = rhs.GetInt8();
-                    break;
-                case VAR_SUBTYPE_UINT16:
-                    *this = rhs.GetUint16();
-                    break;
-                case VAR_SUBTYPE_INT16:
-                    *this = rhs.GetInt16();
-                    break;
-                case VAR_SUBTYPE_UINT32:
-                    *this = rhs.GetUint32();
-                    break;
-                case VAR_SUBTYPE_INT32:
-                    *this = rhs.GetInt32();
-                    break;
-                case VAR_SUBTYPE_UINT64:
-                    *this = rhs.GetUint64();
-                    break;
-                case VAR_SUBTYPE_INT64:
-                    *this = rhs.GetInt64();
-                    break;
-                case VAR_SUBTYPE_FLOAT32:
-                    *this = rhs.GetFloat32();
-                    break;
-                case VAR_SUBTYPE_FLOAT64:
-                    *this = rhs.GetFloat64();
-                    break;
-                default:
-                    break;
-            }
-        case VAR_TYPE_STR:
-            Clear();
-            SetType(VAR_TYPE_STR, VAR_SUBTYPE_NONE);
-            m_Size = rhs.m_Size;
-            m_Value.str = rhs.m_Value.str;
-            rhs.SetType(VAR_TYPE_NONE, VAR_SUBTYPE_NONE);
-            rhs.m_Size = 0;
-            rhs.m_Value.str = nullptr;
-            break;
-        case VAR_TYPE_BUF:
-            Clear();
-            SetType(VAR_TYPE_BUF, VAR_SUBTYPE_NONE);
-            m_Size = rhs.m_Size;
-            m_Value.buf = rhs.m_Value.buf;
-            rhs.SetType(VAR_TYPE_NONE, VAR_SUBTYPE_NONE);
-            rhs.m_Size = 0;
-            rhs.m_Value.buf = nullptr;
-            break;
-        case VAR_TYPE_PTR:
-            m_Size = rhs.m_Size;
-            m_Value.ptr = rhs.m_Value.ptr;
-            break;
-        default:
-            break;
-    }
-
+    Clear();
+    CopyCell(rhs);
+    rhs.ResetCell();
     return *this;
 }
 
 bool Variant::operator==(const Variant &rhs) const {
-    if (GetType() != rhs.GetType())
+    if (GetTag() != rhs.GetTag())
         return false;
 
     switch (GetType()) {
+        case VAR_TYPE_NONE:
         case VAR_TYPE_BOOL:
-            return GetSubtype() == rhs.GetSubtype();
+            return true;
         case VAR_TYPE_CHAR:
             return m_Value.c == rhs.m_Value.c;
         case VAR_TYPE_NUM:
             switch (GetSubtype()) {
                 case VAR_SUBTYPE_UINT8:
-                    return GetUint8() == rhs.GetUint8();
+                    return m_Value.u8 == rhs.m_Value.u8;
                 case VAR_SUBTYPE_INT8:
-                    return GetInt8() == rhs.GetInt8();
+                    return m_Value.i8 == rhs.m_Value.i8;
                 case VAR_SUBTYPE_UINT16:
-                    return GetUint16() == rhs.GetUint16();
+                    return m_Value.u16 == rhs.m_Value.u16;
                 case VAR_SUBTYPE_INT16:
-                    return GetInt16() == rhs.GetInt16();
+                    return m_Value.i16 == rhs.m_Value.i16;
                 case VAR_SUBTYPE_UINT32:
-                    return GetUint32() == rhs.GetUint32();
+                    return m_Value.u32 == rhs.m_Value.u32;
                 case VAR_SUBTYPE_INT32:
-                    return GetInt32() == rhs.GetInt32();
+                    return m_Value.i32 == rhs.m_Value.i32;
                 case VAR_SUBTYPE_UINT64:
-                    return GetUint64() == rhs.GetUint64();
+                    return m_Value.u64 == rhs.m_Value.u64;
                 case VAR_SUBTYPE_INT64:
-                    return GetInt64() == rhs.GetInt64();
+                    return m_Value.i64 == rhs.m_Value.i64;
                 case VAR_SUBTYPE_FLOAT32:
-                    return GetFloat32() == rhs.GetFloat32();
+                    return m_Value.f32 == rhs.m_Value.f32;
                 case VAR_SUBTYPE_FLOAT64:
-                    return GetFloat64() == rhs.GetFloat64();
+                    return m_Value.f64 == rhs.m_Value.f64;
                 default:
-                    break;
+                    return false;
             }
         case VAR_TYPE_STR:
-            return strncmp(m_Value.str, rhs.m_Value.str, (m_Size > rhs.m_Size) ? m_Size : rhs.m_Size) == 0;
+            return GetSize() == rhs.GetSize() && memcmp(GetString(), rhs.GetString(), GetSize()) == 0;
         case VAR_TYPE_BUF:
-            return memcmp(m_Value.buf, rhs.m_Value.buf, (m_Size > rhs.m_Size) ? m_Size : rhs.m_Size) == 0;
+            return GetSize() == rhs.GetSize() && memcmp(GetBuffer(), rhs.GetBuffer(), GetSize()) == 0;
         case VAR_TYPE_PTR:
             return m_Value.ptr == rhs.m_Value.ptr;
         default:
@@ -369,24 +136,174 @@ void Variant::SetBuffer(const void *buf, size_t size) {
     if (!buf || size == 0)
         return;
 
-    auto *buffer = malloc(size);
-    if (buffer) {
+    Assign(VAR_TYPE_BUF, buf, size);
+}
+
+void Variant::SetString(const char *str, Arena *arena) {
+    if (str)
+        Assign(VAR_TYPE_STR, str, strlen(str), arena);
+}
+
+void Variant::SetBuffer(const void *buf, size_t size, Arena *arena) {
+    if (!buf || size == 0)
+        return;
+
+    Assign(VAR_TYPE_BUF, buf, size, arena);
+}
+
+void Variant::Assign(const Variant &rhs, Arena *arena) {
+    // Shared heap blocks are cheaper to reference than to copy, only arena payloads move over.
+    if (rhs.IsArena() && arena && this != &rhs)
+        Assign(rhs.GetType(), rhs.m_Value.ptr, rhs.m_Size, arena);
+    else
+        *this = rhs;
+}
+
+void Variant::SetBuffer(void *buf, size_t size, VariantRelease release, void *userdata) {
+    if (!buf || size == 0 || size > UINT32_MAX) {
+        if (release)
+            release(buf, size, userdata);
+        return;
+    }
+
+    // A control block costs more than copying a payload that fits in the cell.
+    if (size <= VARIANT_INLINE_SIZE) {
+        Assign(VAR_TYPE_BUF, buf, size);
+        if (release)
+            release(buf, size, userdata);
+        return;
+    }
+
+    if (!release) {
         Clear();
+        m_Value.buf = buf;
+        m_Size = static_cast<uint32_t>(size);
+        m_Flags = VAR_FLAG_BORROWED;
         SetType(VAR_TYPE_BUF, VAR_SUBTYPE_NONE);
-        m_Size = size;
-        m_Value.buf = buffer;
-        memcpy(m_Value.buf, buf, m_Size);
+        return;
     }
+
+    auto *control = new(std::nothrow) VariantExternal();
+    if (!control) {
+        release(buf, size, userdata);
+        return;
+    }
+    control->data = buf;
+    control->release = release;
+    control->userdata = userdata;
+
+    Clear();
+    m_Value.ptr = control;
+    m_Size = static_cast<uint32_t>(size);
+    m_Flags = VAR_FLAG_EXTERNAL;
+    SetType(VAR_TYPE_BUF, VAR_SUBTYPE_NONE);
+}
+
+void *Variant::AllocateBuffer(size_t size) {
+    if (size == 0 || !Assign(VAR_TYPE_BUF, nullptr, size))
+        return nullptr;
+    return IsInline() ? GetInlineData() : m_Value.buf;
 }
 
 void Variant::Clear() {
-    if (IsString() && m_Value.str) {
-        free(m_Value.str);
-    } else if (IsBuffer() && m_Value.buf) {
-        free(m_Value.buf);
+    if (HasHeapData())
+        ReleaseBlock(m_Value.ptr);
+    else if (IsExternal())
+        ReleaseExternal(m_Value.ptr, m_Size);
+    ResetCell();
+}
+
+const void *Variant::GetExternalData() const {
+    return static_cast<const VariantExternal *>(m_Value.ptr)->data;
+}
+
+void *Variant::AllocateBlock(size_t size) {
+    void *mem = malloc(sizeof(VariantBlock) + size);
+    if (!mem)
+        return nullptr;
+
+    new(mem) VariantBlock();
+    return static_cast<char *>(mem) + sizeof(VariantBlock);
+}
+
+void Variant::RetainBlock(void *data) {
+    GetBlock(data)->refs.AddRef();
+}
+
+void Variant::ReleaseBlock(void *data) {
+    VariantBlock *block = GetBlock(data);
+    if (block->refs.Release() == 0) {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        block->~VariantBlock();
+        free(block);
+    }
+}
+
+void Variant::RetainExternal(void *control) {
+    static_cast<VariantExternal *>(control)->refs.AddRef();
+}
+
+void Variant::ReleaseExternal(void *control, size_t size) {
+    auto *external = static_cast<VariantExternal *>(control);
+    if (external->refs.Release() == 0) {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        external->release(external->data, size, external->userdata);
+        delete external;
+    }
+}
+
+bool Variant::Assign(VariantType type, const void *data, size_t size, Arena *arena) {
+    if (size > UINT32_MAX)
+        return false;
+
+    // Strings keep their terminator in the storage but not in the size.
+    const size_t bytes = (type == VAR_TYPE_STR) ? size + 1 : size;
+
+    if (bytes <= VARIANT_INLINE_SIZE) {
+        // The source may live in this very cell, so stage it before clearing.
+        char staging[VARIANT_INLINE_SIZE] = {};
+        if (data)
+            memcpy(staging, data, size);
+
+        Clear();
+        char *dest = GetInlineData();
+        memcpy(dest, staging, size);
+        memset(dest + size, 0, VARIANT_INLINE_SIZE - size);
+        m_Flags = (uint8_t)(VAR_FLAG_INLINE | (size << VAR_FLAG_LENGTH_BIT));
+    } else {
+        auto *buffer = static_cast<char *>(arena ? arena->Allocate(bytes) : AllocateBlock(bytes));
+        if (!buffer)
+            return false;
+        if (data)
+            memcpy(buffer, data, size);
+        if (type == VAR_TYPE_STR)
+            buffer[size] = '\0';
+
+        Clear();
+        m_Value.ptr = buffer;
+        m_Size = static_cast<uint32_t>(size);
+        if (arena)
+            m_Flags = VAR_FLAG_ARENA;
     }
 
-    SetType(VAR_TYPE_NONE, VAR_SUBTYPE_NONE);
+    SetType(type, VAR_SUBTYPE_NONE);
+    return true;
+}
+
+void Variant::CopyCell(const Variant &rhs) {
+    m_Value = rhs.m_Value;
+    m_Size = rhs.m_Size;
+    m_Spare[0] = rhs.m_Spare[0];
+    m_Spare[1] = rhs.m_Spare[1];
+    m_Flags = rhs.m_Flags;
+    m_Tag = rhs.m_Tag;
+}
+
+void Variant::ResetCell() {
+    m_Value.u64 = 0;
     m_Size = 0;
-    memset(&m_Value, 0, sizeof(VariantValue));
+    m_Spare[0] = 0;
+    m_Spare[1] = 0;
+    m_Flags = 0;
+    m_Tag = VAR_TYPE_NONE;
 }
@@ -1,9 +1,12 @@
 #ifndef BALLOON_VARIANT_H
 #define BALLOON_VARIANT_H
 
+#include <cstddef>
 #include <cstdint>
 #include <cstring>
 
+#include "Arena.h"
+
 namespace balloon {
     /** Type of Variant value (3 bit). */
     typedef uint8_t VariantType;
@@ -43,7 +46,21 @@ namespace balloon {
 #define VAR_TAG_MASK         ((uint8_t)0xFF)     /* 11111111 */
 #define VAR_TAG_BIT          ((uint8_t)8)
 
-    constexpr size_t VARIANT_VALUE_SIZE = 4;
+/** Storage flags of Variant cell. */
+#define VAR_FLAG_INLINE      ((uint8_t)0x01)     /* _______1 */
+#define VAR_FLAG_ARENA       ((uint8_t)0x02)     /* ______1_ */
+#define VAR_FLAG_BORROWED    ((uint8_t)0x04)     /* _____1__ */
+#define VAR_FLAG_EXTERNAL    ((uint8_t)0x08)     /* ____1___ */
+#define VAR_FLAG_LENGTH_MASK ((uint8_t)0xF0)     /* 1111____ */
+#define VAR_FLAG_LENGTH_BIT  ((uint8_t)4)
+
+    constexpr size_t VARIANT_VALUE_SIZE = 8;
+
+    /** Releases a buffer stored by reference once the last cell referencing it is cleared. */
+    typedef void (*VariantRelease)(void *data, size_t size, void *userdata);
+
+    /** Strings shorter than 14 characters and buffers up to 14 bytes are stored in the cell. */
+    constexpr size_t VARIANT_INLINE_SIZE = 14;
 
     typedef union VariantValue {
         bool        b;
@@ -64,6 +81,20 @@ namespace balloon {
         uint8_t     raw[VARIANT_VALUE_SIZE];
     } VariantValue;
 
+    /**
+     * @brief Fixed 16-byte value cell.
+     *
+     * Layout: 8-byte value, 4-byte size, 2 spare bytes, storage flags and tag.
+     * Small strings and buffers reuse the first 14 bytes as inline storage,
+     * their length is kept in the upper bits of the flags.
+     *
+     * Larger payloads live in a reference counted heap block which copies share,
+     * payloads are never modified in place once stored. Payloads placed in an arena
+     * belong to the arena, copying such a cell out duplicates the payload.
+     *
+     * Buffers can also be stored by reference: borrowed ones are kept alive by the caller,
+     * external ones carry a shared control block calling the release callback of their owner.
+     */
     class Variant final {
     public:
         Variant();
@@ -81,7 +112,7 @@ namespace balloon {
         Variant(double value) { *this = value; } // NOLINT(google-explicit-constructor)
         Variant(const char *value) { *this = value; } // NOLINT(google-explicit-constructor)
         Variant(const void *buf, size_t size);
-        Variant(void *ptr, size_t size) : m_Tag(VAR_TYPE_PTR), m_Size(size) {
+        Variant(void *ptr, size_t size) : m_Size(static_cast<uint32_t>(size)), m_Tag(VAR_TYPE_PTR) {
             m_Value.ptr = ptr;
         }
 
@@ -100,6 +131,7 @@ namespace balloon {
                 m_Size = 0;
             }
             SetType(VAR_TYPE_BOOL, value ? VAR_SUBTYPE_TRUE : VAR_SUBTYPE_FALSE);
+            m_Value.b = value;
             return *this;
         }
 
@@ -194,7 +226,7 @@ namespace balloon {
         }
 
         Variant &operator=(float value) {
-            if (!IsFloat64()) {
+            if (!IsFloat32()) {
                 Clear();
                 SetType(VAR_TYPE_NUM, VAR_SUBTYPE_FLOAT32);
                 m_Size = sizeof(value);
@@ -216,13 +248,13 @@ namespace balloon {
         Variant& operator=(const char *value);
 
         Variant& operator=(void *value) {
-                if (!IsPtr()) {
-                    Clear();
-                    SetType(VAR_TYPE_PTR, VAR_SUBTYPE_NONE);
-                    m_Size = sizeof(value);
-                }
-                m_Value.ptr = value;
-                return *this;
+            if (!IsPtr()) {
+                Clear();
+                SetType(VAR_TYPE_PTR, VAR_SUBTYPE_NONE);
+                m_Size = sizeof(value);
+            }
+            m_Value.ptr = value;
+            return *this;
         }
 
         Variant& operator=(Variant &&rhs) noexcept;
@@ -240,7 +272,7 @@ namespace balloon {
         bool operator==(int64_t value) const { return IsInt64() && m_Value.i64 == value; }
         bool operator==(float value) const { return IsFloat32() && m_Value.f32 == value; }
         bool operator==(double value) const { return IsFloat64() && m_Value.f64 == value; }
-        bool operator==(const char *value) const { return IsString() && strncmp(m_Value.str, value, m_Size) == 0; }
+        bool operator==(const char *value) const { return IsString() && value && strcmp(GetString(), value) == 0; }
         bool operator==(void *value) const { return IsPtr() && m_Value.ptr == value; }
 
         bool operator!=(const Variant &rhs) const { return !(*this == rhs); }
@@ -327,33 +359,44 @@ namespace balloon {
             return GetType() == VAR_TYPE_PTR;
         }
 
+        bool IsInline() const {
+            return (m_Flags & VAR_FLAG_INLINE) != 0;
+        }
+
+        bool IsArena() const {
+            return (m_Flags & VAR_FLAG_ARENA) != 0;
+        }
+
+        bool IsBorrowed() const {
+            return (m_Flags & VAR_FLAG_BORROWED) != 0;
+        }
+
+        bool IsExternal() const {
+            return (m_Flags & VAR_FLAG_EXTERNAL) != 0;
+        }
+
         uint8_t GetTag() const {
-            return (uint8_t)(((uint8_t)m_Tag) & VAR_TAG_MASK);
+            return m_Tag;
         }
 
         VariantType GetType() const {
-            return (VariantType)(((uint8_t)m_Tag) & VAR_TYPE_MASK);
+            return (VariantType)(m_Tag & VAR_TYPE_MASK);
         }
 
         VariantSubtype GetSubtype() const {
-            return (VariantSubtype)(((uint8_t)m_Tag) & VAR_SUBTYPE_MASK);
+            return (VariantSubtype)(m_Tag & VAR_SUBTYPE_MASK);
         }
 
         void SetTag(uint8_t tag) {
-            uint32_t newTag = m_Tag;
-            newTag = (newTag & (~(uint32_t)VAR_TAG_MASK)) | (uint32_t)tag;
-            m_Tag = newTag;
+            m_Tag = tag;
         }
 
         void SetType(VariantType type, VariantSubtype subtype) {
-            uint8_t tag = (type | subtype);
-            uint32_t newTag = m_Tag;
-            newTag = (newTag & (~(uint32_t)VAR_TAG_MASK)) | (uint32_t)tag;
-            m_Tag = newTag;
+            m_Tag = (uint8_t)(type | subtype);
         }
 
         size_t GetSize() const {
-            return m_Size;
+            return IsInline() ? (size_t)(m_Flags >> VAR_FLAG_LENGTH_BIT) : m_Size;
         }
 
         bool GetBool() const {
@@ -457,36 +500,86 @@ namespace balloon {
             else if (IsFloat32())
                 return m_Value.f32;
             else if (IsInt8())
-                return static_cast<float>(m_Value.i8);
+                return static_cast<double>(m_Value.i8);
             else if (IsInt16())
-                return static_cast<float>(m_Value.i16);
+                return static_cast<double>(m_Value.i16);
             else if (IsInt32())
-                return static_cast<float>(m_Value.i32);
+                return static_cast<double>(m_Value.i32);
             else if (IsInt64())
-                return static_cast<float>(m_Value.i64);
+                return static_cast<double>(m_Value.i64);
             else
                 return 0.0;
         }
 
         const char *GetString() const {
-            return (IsString()) ? m_Value.str : nullptr;
+            if (!IsString())
+                return nullptr;
+            return IsInline() ? GetInlineData() : m_Value.str;
         }
 
         const void *GetBuffer() const {
-            return (IsBuffer()) ? m_Value.buf : nullptr;
+            if (!IsBuffer())
+                return nullptr;
+            if (IsInline())
+                return GetInlineData();
+            return IsExternal() ? GetExternalData() : m_Value.buf;
         }
 
         void *GetPtr() const {
             return (IsPtr()) ? m_Value.ptr : nullptr;
         }
 
+        // Copies the raw value when the tag matches exactly, inline payloads are not held by the value.
+        // Booleans carry their value in the subtype as well, both match the plain boolean tag.
+        bool LoadExact(uint8_t tag, void *dst, size_t size) const {
+            if (m_Tag != tag && (tag != VAR_TYPE_BOOL || !IsBool()))
+                return false;
+            if (IsInline() || size > VARIANT_VALUE_SIZE)
+                return false;
+            memcpy(dst, &m_Value, size);
+            return true;
+        }
+
         void SetBuffer(const void *buf, size_t size);
 
+        void SetString(const char *str, Arena *arena);
+        void SetBuffer(const void *buf, size_t size, Arena *arena);
+        void Assign(const Variant &rhs, Arena *arena);
+
+        void SetBuffer(void *buf, size_t size, VariantRelease release, void *userdata);
+        void *AllocateBuffer(size_t size);
+
     private:
-        uint32_t m_Tag = VAR_TYPE_NONE;
-        size_t m_Size = 0;
+        // The cell is standard layout, so its leading bytes can be addressed as characters.
+        char *GetInlineData() { return reinterpret_cast<char *>(this); }
+        const char *GetInlineData() const { return reinterpret_cast<const char *>(this); }
+
+        bool HasHeapData() const {
+            return !(m_Flags & (VAR_FLAG_INLINE | VAR_FLAG_ARENA | VAR_FLAG_BORROWED | VAR_FLAG_EXTERNAL)) &&
+                   (IsString() || IsBuffer()) && m_Value.ptr;
+        }
+
+        const void *GetExternalData() const;
+
+        static void *AllocateBlock(size_t size);
+        static void RetainBlock(void *data);
+        static void ReleaseBlock(void *data);
+
+        static void RetainExternal(void *control);
+        static void ReleaseExternal(void *control, size_t size);
+
+        bool Assign(VariantType type, const void *data, size_t size, Arena *arena = nullptr);
+        void CopyCell(const Variant &rhs);
+        void ResetCell();
+
         VariantValue m_Value = {};
+        uint32_t m_Size = 0;
+        uint8_t m_Spare[2] = {};
+        uint8_t m_Flags = 0;
+        uint8_t m_Tag = VAR_TYPE_NONE;
     };
+
+    static_assert(sizeof(Variant) == 16, "Variant must be a 16-byte cell");
 }
 
 
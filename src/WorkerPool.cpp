@@ -0,0 +1,95 @@
+#include "WorkerPool.h"
+
+#include <algorithm>
+
+using namespace balloon;
+
+WorkerPool::WorkerPool() = default;
+
+WorkerPool::~WorkerPool() {
+    Stop();
+}
+
+bool WorkerPool::Start(size_t threadCount) {
+    std::lock_guard<std::mutex> guard(m_Mutex);
+
+    if (!m_Threads.empty())
+        return false;
+
+    // Leave a core to the game thread.
+    if (threadCount == 0) {
+        size_t cores = std::thread::hardware_concurrency();
+        threadCount = std::min<size_t>(std::max<size_t>(cores, 2) - 1, 4);
+    }
+
+    m_Stopping = false;
+    for (size_t i = 0; i < threadCount; ++i)
+        m_Threads.emplace_back(&WorkerPool::Run, this);
+    return true;
+}
+
+void WorkerPool::Stop() {
+    std::vector<std::thread> threads;
+    {
+        std::lock_guard<std::mutex> guard(m_Mutex);
+        if (m_Threads.empty())
+            return;
+
+        m_Stopping = true;
+        threads.swap(m_Threads);
+    }
+    m_Condition.notify_all();
+
+    // Workers finish the queued jobs before exiting.
+    for (auto &thread: threads)
+        thread.join();
+}
+
+bool WorkerPool::IsRunning() const {
+    std::lock_guard<std::mutex> guard(m_Mutex);
+    return !m_Threads.empty();
+}
+
+bool WorkerPool::Submit(Task task, void *data) {
+    if (!task)
+        return false;
+
+    {
+        std::lock_guard<std::mutex> guard(m_Mutex);
+        if (m_Threads.empty())
+            return false;
+        PushJob({task, data});
+    }
+    m_Condition.notify_one();
+    return true;
+}
+
+void WorkerPool::PushJob(const Job &job) {
+    if (m_JobCount == m_Jobs.size()) {
+        std::vector<Job> jobs(std::max<size_t>(m_Jobs.size() * 2, 16));
+        for (size_t i = 0; i < m_JobCount; ++i)
+            jobs[i] = m_Jobs[(m_JobHead + i) & (m_Jobs.size() - 1)];
+        m_Jobs.swap(jobs);
+        m_JobHead = 0;
+    }
+
+    m_Jobs[(m_JobHead + m_JobCount) & (m_Jobs.size() - 1)] = job;
+    ++m_JobCount;
+}
+
+void WorkerPool::Run() {
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    while (true) {
+        m_Condition.wait(lock, [this] { return m_Stopping || m_JobCount != 0; });
+        if (m_JobCount == 0)
+            return;
+
+        Job job = m_Jobs[m_JobHead];
+        m_JobHead = (m_JobHead + 1) & (m_Jobs.size() - 1);
+        --m_JobCount;
+
+        lock.unlock();
+        job.task(job.data);
+        lock.lock();
+    }
+}
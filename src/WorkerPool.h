@@ -0,0 +1,50 @@
+#ifndef BALLOON_WORKERPOOL_H
+#define BALLOON_WORKERPOOL_H
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace balloon {
+    class WorkerPool final {
+    public:
+        typedef void (*Task)(void *data);
+
+        WorkerPool();
+
+        WorkerPool(const WorkerPool &rhs) = delete;
+        WorkerPool(WorkerPool &&rhs) noexcept = delete;
+
+        ~WorkerPool();
+
+        WorkerPool &operator=(const WorkerPool &rhs) = delete;
+        WorkerPool &operator=(WorkerPool &&rhs) noexcept = delete;
+
+        bool Start(size_t threadCount = 0);
+        void Stop();
+        bool IsRunning() const;
+
+        bool Submit(Task task, void *data);
+
+    private:
+        struct Job {
+            Task task;
+            void *data;
+        };
+
+        void PushJob(const Job &job);
+        void Run();
+
+        mutable std::mutex m_Mutex;
+        std::condition_variable m_Condition;
+        // Circular queue of power of two size, it only grows so submitting does not allocate once warmed up.
+        std::vector<Job> m_Jobs;
+        size_t m_JobHead = 0;
+        size_t m_JobCount = 0;
+        std::vector<std::thread> m_Threads;
+        bool m_Stopping = false;
+    };
+}
+
+#endif // BALLOON_WORKERPOOL_H
@@ -0,0 +1,113 @@
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "EventJournal.h"
+#include "EventManager.h"
+
+using namespace balloon;
+
+namespace {
+    // Counts the replayed events of every type.
+    class EventCounter final : public IEventListener {
+    public:
+        int OnEvent(const IEvent *event) override {
+            EventType type = event->GetType();
+            if (type >= m_Counts.size())
+                m_Counts.resize(type + 1, 0);
+            ++m_Counts[type];
+            return 1;
+        }
+
+        const std::vector<size_t> &GetCounts() const { return m_Counts; }
+
+    private:
+        std::vector<size_t> m_Counts;
+    };
+
+    void PrintUsage(const char *program) {
+        fprintf(stderr, "Usage: %s [-n] [-o output] journal\n", program);
+        fprintf(stderr, "  -n         Also replay the events sent by listeners during another dispatch.\n");
+        fprintf(stderr, "  -o output  Record the replayed events to another journal.\n");
+    }
+}
+
+int main(int argc, char *argv[]) {
+    const char *input = nullptr;
+    const char *output = nullptr;
+    bool nested = false;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-n") == 0) {
+            nested = true;
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else if (argv[i][0] != '-' && !input) {
+            input = argv[i];
+        } else {
+            PrintUsage(argv[0]);
+            return 2;
+        }
+    }
+
+    if (!input) {
+        PrintUsage(argv[0]);
+        return 2;
+    }
+
+    auto &manager = EventManager::GetInstance();
+
+    EventCounter counter;
+    manager.AddListener("*", &counter);
+
+    if (output) {
+        auto *journal = new EventJournal();
+        if (!journal->Open(output)) {
+            fprintf(stderr, "Failed to create journal %s\n", output);
+            delete journal;
+            return 1;
+        }
+        manager.SetJournal(journal);
+    }
+
+    EventReplayer replayer(manager, nested);
+    if (!replayer.Open(input)) {
+        fprintf(stderr, "Failed to open journal %s\n", input);
+        return 1;
+    }
+
+    // Frames are driven the way the game loop drives them, without waiting for real time.
+    uint64_t frames = 0;
+    bool replaying = true;
+    while (replaying) {
+        replaying = replayer.ReplayFrame();
+        manager.DispatchEvents();
+        manager.UpdateTimers();
+        ++frames;
+    }
+
+    bool failed = replayer.HasError();
+    replayer.Close();
+    manager.SetJournal(nullptr);
+
+    size_t total = 0;
+    const auto &counts = counter.GetCounts();
+    for (EventType type = 0; type < counts.size(); ++type) {
+        if (counts[type] == 0)
+            continue;
+        const char *name = manager.GetEventTypeName(type);
+        printf("%8zu  %s\n", counts[type], name ? name : "(unknown)");
+        total += counts[type];
+    }
+    printf("%zu events in %llu frames\n", total, static_cast<unsigned long long>(frames));
+
+    manager.RemoveListener("*", &counter);
+    manager.Reset();
+
+    if (failed) {
+        fprintf(stderr, "Journal %s is truncated or corrupt after frame %llu\n", input,
+                static_cast<unsigned long long>(replayer.GetFrame()));
+        return 1;
+    }
+    return 0;
+}